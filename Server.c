@@ -4,6 +4,9 @@
 /*   Copyright(c) 2017 by Felix Knobl, FH Technikum Wien    */
 /************************************************************/
 
+// struct ucred (SO_PEERCRED) is a GNU extension
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -12,15 +15,35 @@
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/mman.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <string.h>
 #include <strings.h>
+#include <stdarg.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <netdb.h>
 #include <signal.h>
+#include <poll.h>
 #include <time.h>
+#include <stdint.h>
 #include <math.h>
+#include <float.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <dirent.h>
+#include <zlib.h>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+#ifdef USE_BROTLI
+#include <brotli/encode.h>
+#endif
 
 
 #define DEFAULT_PORTNUMBER 	6655
@@ -28,34 +51,513 @@
 #define MAX_BUFFER_LENGTH 			1024
 #define MAX_CLIENTS		  			1024
 #define MAX_PENDING_CONNECTIONS		4096
+#define MAX_LISTENERS				3
+#define MAX_ALLOWED_USERS			16
+#define MAX_CLIENT_PROCESSES		4096
 #define MAX_REQUEST_LENGTH			32768
+#define CLIENT_RECEIVE_TIMEOUT_MS	30000
 #define MAX_RESPONSE_LENGTH			4096
 #define MAX_PATH_LENGTH				256
 #define MAX_CONTENT_LENGTH_BUFFER 	256
 #define MAX_PAYLOAD_LENGTH			4096
 #define MAX_URI_LENGTH				64
 #define MAX_CONTENT_TYPE_LENGTH		32
-
-// BUILD: clang -Wall -lm --pedantic -D_POSIX_C_SOURCE=200809L Server.c
+#define MAX_CHUNK_HEADER_LENGTH		16
+#define MAX_RANGE_LINE_LENGTH		64
+#define MAX_RANGE_POINTS			100000000
+#define RANGE_BLOCK_SIZE			256
+#define MAX_NUMERIC_THREADS			64
+#define NUMERIC_SUBINTERVALS		64
+#define MAX_NUMERIC_DEPTH			48
+#define MAX_NUMERIC_ITERATIONS		200
+#define NUMERIC_TOLERANCE			1e-10
+#define NUMERIC_DEADLINE_MS			2000
+#define MAX_HEADER_VALUE_LENGTH		256
+#define MAX_MATRIX_BODY_LENGTH		(64 * 1024 * 1024)
+#define MAX_MATRIX_ELEMENTS			(16 * 1024 * 1024)
+#define MAX_MATRIX_THREADS			64
+#define MATRIX_THREAD_THRESHOLD		(1 << 24)
+#define GEMM_MR						4
+#define GEMM_NR						8
+#define GEMM_MC						64
+#define GEMM_KC						256
+#define GEMM_NC						512
+#define MAX_BIG_BODY_LENGTH			(4 * 1024 * 1024)
+#define MAX_BIG_POWERS				40
+#define BIG_KARATSUBA_THRESHOLD		32
+#define BIG_NEWTON_THRESHOLD		64
+#define BIG_CONVERSION_THRESHOLD	32
+#define BIG_DIVISION_SCALE			50
+#define MAX_STATS_THREADS			64
+#define MAX_STATS_QUANTILES			16
+#define MAX_STATS_TOKEN_LENGTH		128
+#define STATS_BLOCK_SIZE			(64 * 1024)
+#define STATS_BATCH_SIZE			512
+#define STATS_THREAD_THRESHOLD		(1024 * 1024)
+#define SKETCH_SIZE					200
+#define SKETCH_MIN_CAPACITY			8
+#define MAX_SKETCH_LEVELS			40
+#define RPC_HEADER_LENGTH			12
+#define RPC_BUFFER_LENGTH			(256 * 1024)
+#define RPC_STATUS_OK				0
+#define RPC_STATUS_DOMAIN_ERROR		1
+#define RPC_STATUS_INVALID			2
+#define RPC_STATUS_RATE_LIMITED		3
+#define MAX_WS_MESSAGE_LENGTH		(64 * 1024)
+#define MAX_WS_HEADER_LENGTH		14
+#define MAX_WS_CONTROL_LENGTH		125
+#define MIN_WS_STREAM_INTERVAL		10
+#define WS_GUID						"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define LISTEN_FDS_VARIABLE			"HTTPCALC_LISTEN_FDS"
+#define READY_FD_VARIABLE			"HTTPCALC_READY_FD"
+#define RESTART_READY_TIMEOUT_MS	10000
+#define DRAIN_DEADLINE_MS			30000
+#define WARM_BIG_POWERS				13
+#define RATE_CLASSES				4
+#define RATE_TABLE_SIZE				65536
+#define RATE_TABLE_PROBES			8
+#define RATE_TOKEN_BITS				24
+#define MAX_RATE_BURST				16000
+#define MAX_RATE					1000000
+#define TRACE_SLOTS					4096
+#define MAX_TRACE_EVENTS			32
+#define MAX_TRACE_LINE_LENGTH		512
+#define TRACE_FILE_FORMAT			"/tmp/httpcalc-trace-%d.json"
+#define MAX_STATIC_ASSETS			256
+#define MAX_STATIC_ASSET_LENGTH		(4 * 1024 * 1024)
+#define MAX_STATIC_DEPTH			8
+#define MIN_COMPRESSED_LENGTH		256
+#define MAX_STARTUP_COMPRESSION		(1024 * 1024)
+
+// BUILD: clang -Wall -lm -lz -pthread --pedantic -D_POSIX_C_SOURCE=200809L Server.c
+// (add -DUSE_BROTLI -lbrotlienc to build brotli variants of the static files)
 // RUN: change PWD before start
 
 int clients[MAX_CLIENTS];
 
+// Users which may connect to the Unix domain socket besides root and the server's own user
+uid_t allowedUsers[MAX_ALLOWED_USERS];
+int allowedUserCount = 0;
+
+// Running client processes, a draining server terminates them at the deadline. They are only
+// changed with SIGCHLD blocked or from its handler, which runs while the main loop waits.
+pid_t clientProcesses[MAX_CLIENT_PROCESSES];
+int clientProcessCount = 0;
+
+// Set by SIGUSR2 to hand the listening sockets over to a newly started server binary
+volatile sig_atomic_t restartRequested = 0;
+
+// Mathematical functions which can be evaluated by name (e.g. over a range)
+typedef double (*mathFunction)(double);
+
+typedef struct
+{
+	const char *name;
+	mathFunction function;
+} mathFunctionEntry;
+
+const mathFunctionEntry mathFunctions[] =
+{
+	{"sin",  sin},
+	{"cos",  cos},
+	{"tan",  tan},
+	{"sqrt", sqrt}
+};
+
+// Scalar operations of the calculator, shared by the HTTP handlers and the binary protocol.
+// The values are the opcodes of the binary protocol.
+typedef enum
+{
+	OPERATION_ADD = 1,
+	OPERATION_SUB = 2,
+	OPERATION_MUL = 3,
+	OPERATION_DIV = 4,
+	OPERATION_MOD = 5,
+	OPERATION_SQRT = 6,
+	OPERATION_SIN = 7,
+	OPERATION_COS = 8,
+	OPERATION_TAN = 9,
+	OPERATION_RANDOM = 10
+} calcOperation;
+
+// Numeric operations which are solved over an interval
+typedef enum
+{
+	NUMERIC_INTEGRATE,
+	NUMERIC_ROOT,
+	NUMERIC_MINIMIZE
+} numericOperation;
+
+// Result states of a numeric task
+#define NUMERIC_OK			0
+#define NUMERIC_NOT_FOUND	1
+#define NUMERIC_TIMEOUT		2
+
+// One subinterval of a numeric operation, solved by one of the worker threads
+typedef struct
+{
+	numericOperation operation;
+	mathFunction function;
+	double a;
+	double b;
+	double tolerance;
+	struct timespec deadline;
+	double position;
+	double value;
+	double error;
+	int status;
+} numericTask;
+
+// Subintervals of a numeric operation, the worker threads take the next unsolved one
+typedef struct
+{
+	numericTask *tasks;
+	int count;
+	_Atomic int next;
+} numericQueue;
+
+// Dense row-major matrix, vectors are matrices with one row or column
+typedef struct
+{
+	uint32_t rows;
+	uint32_t columns;
+	double *values;
+} matrix;
+
+// Row range of a matrix multiplication C = A * B, computed by one worker thread
+typedef struct
+{
+	const double *a;
+	const double *b;
+	double *c;
+	int m;
+	int n;
+	int k;
+	int rowStart;
+	int rowEnd;
+} matrixTask;
+
+// Arbitrary-precision natural number: little endian 32 bit limbs without leading zero limbs
+typedef struct
+{
+	uint32_t *limbs;
+	size_t length;
+} bigNumber;
+
+// Arbitrary-precision decimal number: (-1)^negative * magnitude / 10^scale
+typedef struct
+{
+	bigNumber magnitude;
+	bool negative;
+	size_t scale;
+} bigDecimal;
+
+// KLL quantile sketch: the items of level h stand for 2^h input values. A level which
+// reaches its capacity is sorted and every second item is promoted to the next level.
+typedef struct
+{
+	double items[MAX_SKETCH_LEVELS][SKETCH_SIZE];
+	int sizes[MAX_SKETCH_LEVELS];
+	int capacities[MAX_SKETCH_LEVELS];
+	int levels;
+	uint64_t random;
+} quantileSketch;
+
+// Partial descriptive statistics of a part of the input, mergeable in any order
+typedef struct
+{
+	long long count;
+	double sum;
+	double mean;
+	double m2;
+	double minimum;
+	double maximum;
+	quantileSketch sketch;
+} statisticsState;
+
+// Bounded pool of input blocks, filled by the thread reading the request body and
+// consumed by the statistics workers. Each worker keeps its own partial state.
+typedef struct
+{
+	pthread_mutex_t lock;
+	pthread_cond_t filled;
+	pthread_cond_t emptied;
+	char *blocks[2 * MAX_STATS_THREADS];
+	size_t lengths[2 * MAX_STATS_THREADS];
+	int freeBlocks[2 * MAX_STATS_THREADS];
+	int filledBlocks[2 * MAX_STATS_THREADS];
+	int blockCount;
+	int freeCount;
+	int filledStart;
+	int filledCount;
+	bool binary;
+	bool finished;
+	bool invalid;
+} statisticsQueue;
+
+typedef struct
+{
+	statisticsQueue *queue;
+	statisticsState state;
+} statisticsTask;
+
+// State of a WebSocket session: received frames, the message assembled from fragments,
+// the buffers for the replies and the stream of random numbers pushed by the server
+typedef struct
+{
+	int clientIndex;
+	unsigned char *input;
+	size_t inputLength;
+	unsigned char *message;
+	size_t messageLength;
+	int messageOpcode;
+	unsigned char *output;
+	unsigned char *reply;
+	double *values;
+	double *results;
+	bool streaming;
+	double streamRange;
+	long streamInterval;
+	struct timespec nextPush;
+} webSocketSession;
+
+// Request body of a POST request. The bytes received together with the
+// request header are consumed first, the rest is read from the socket.
+// A chunked body is decoded while reading, remaining then counts the bytes
+// left in the current chunk and buffer holds the received chunk size lines.
+typedef struct
+{
+	int clientIndex;
+	char *pending;
+	size_t pendingLength;
+	long long remaining;
+	bool chunked;
+	bool finished;
+	char buffer[MAX_BUFFER_LENGTH];
+} requestBody;
+
+// Buffered response body which is sent in chunks of at most MAX_PAYLOAD_LENGTH bytes.
+// The buffer reserves room in front of the payload for the chunk size line and
+// behind it for the terminating CRLF, so a chunk is sent with a single write.
+typedef struct
+{
+	int clientIndex;
+	bool chunked;
+	size_t length;
+	char buffer[MAX_CHUNK_HEADER_LENGTH + MAX_PAYLOAD_LENGTH + 2];
+} responseStream;
+
+// Route classes with separate rate limits, the connections of a client are limited as well.
+// Frames of the binary protocol and WebSocket messages count as heavy requests.
+typedef enum
+{
+	RATE_CLASS_STATIC = 0,
+	RATE_CLASS_CALC = 1,
+	RATE_CLASS_HEAVY = 2,
+	RATE_CLASS_CONNECT = 3
+} rateClass;
+
+// Token bucket parameters of a route class: tokens per second and bucket size (rate 0 is unlimited)
+typedef struct
+{
+	const char *name;
+	uint32_t rate;
+	uint32_t burst;
+} rateLimit;
+
+// Token bucket of a client address and route class in the shared table. The key is 0 for a free
+// entry, the state packs the time of the last update (milliseconds) above RATE_TOKEN_BITS
+// bits of milli-tokens.
+typedef struct
+{
+	_Atomic uint64_t key;
+	_Atomic uint64_t state;
+} rateBucket;
+
+// Rate limits per route class, changed with -L
+rateLimit rateLimits[RATE_CLASSES] = {{"static", 200, 400}, {"calc", 100, 200}, {"heavy", 10, 20}, {"connect", 400, 800}};
+
+// Token buckets shared by all client processes
+rateBucket *rateTable = NULL;
+
+// Address and rate limiting key of the client served by this process
+struct sockaddr_storage clientAddress;
+uint64_t clientRateKey = 0;
+
+// Phases of a request which are recorded by the tracing
+typedef enum
+{
+	TRACE_RECV = 0,
+	TRACE_PARSE = 1,
+	TRACE_ROUTE = 2,
+	TRACE_CONVERT = 3,
+	TRACE_CALCULATE = 4,
+	TRACE_HEADER = 5,
+	TRACE_FORMAT = 6,
+	TRACE_WRITE = 7,
+	TRACE_CLOSE = 8,
+	TRACE_PHASES = 9
+} tracePhase;
+
+// One phase of a traced request, times in nanoseconds of the monotonic clock
+typedef struct
+{
+	uint64_t start;
+	uint64_t duration;
+	tracePhase phase;
+} traceEvent;
+
+// Trace of one request, recorded by the client process
+typedef struct
+{
+	int pid;
+	int eventCount;
+	uint64_t start;
+	uint64_t duration;
+	char url[MAX_URI_LENGTH];
+	traceEvent events[MAX_TRACE_EVENTS];
+} traceData;
+
+// Slot of the shared trace ring. The sequence is odd while the data is written (seqlock),
+// so the readers skip slots which change while they copy them.
+typedef struct
+{
+	_Atomic uint64_t sequence;
+	traceData data;
+} traceRecord;
+
+// Ring of the finished request traces, shared by all client processes
+typedef struct
+{
+	int serverPid;
+	_Atomic uint64_t requests;
+	_Atomic uint64_t next;
+	traceRecord records[TRACE_SLOTS];
+} traceBuffer;
+
+// Writes a part of the trace output
+typedef bool (*traceWriter)(void *context, const char *text, size_t length);
+
+// Every traceSampling-th request is traced (-t), the ring only exists with tracing enabled
+int traceSampling = 0;
+traceBuffer *traceTable = NULL;
+
+// Trace of the request served by this process
+traceData currentTrace;
+bool traceActive = false;
+
+// Set by SIGUSR1 to write the traces into a file
+volatile sig_atomic_t traceDumpRequested = 0;
+
+// Content encodings of the static files, the encoded variants are preferred in reverse order
+typedef enum
+{
+	ENCODING_IDENTITY = 0,
+	ENCODING_GZIP = 1,
+	ENCODING_BROTLI = 2,
+	ENCODINGS = 3
+} contentEncoding;
+
+// Content type of a file extension, compressible types get encoded variants
+typedef struct
+{
+	const char *extension;
+	const char *contentType;
+	bool compressible;
+} mimeType;
+
+const mimeType mimeTypes[] =
+{
+	{".html", "text/html", true},
+	{".htm", "text/html", true},
+	{".css", "text/css", true},
+	{".js", "text/javascript", true},
+	{".mjs", "text/javascript", true},
+	{".json", "application/json", true},
+	{".xml", "application/xml", true},
+	{".txt", "text/plain", true},
+	{".csv", "text/csv", true},
+	{".md", "text/markdown", true},
+	{".svg", "image/svg+xml", true},
+	{".ico", "image/x-icon", true},
+	{".wasm", "application/wasm", true},
+	{".png", "image/png", false},
+	{".jpg", "image/jpeg", false},
+	{".jpeg", "image/jpeg", false},
+	{".gif", "image/gif", false},
+	{".webp", "image/webp", false},
+	{".woff", "font/woff", false},
+	{".woff2", "font/woff2", false},
+	{".pdf", "application/pdf", false}
+};
+
+// Static file held in memory with its encoded variants (NULL where there is no smaller one)
+typedef struct
+{
+	char path[MAX_PATH_LENGTH];
+	const char *contentType;
+	char *data[ENCODINGS];
+	size_t length[ENCODINGS];
+} staticAsset;
+
+// Static files below the root directory, loaded at startup
+staticAsset staticAssets[MAX_STATIC_ASSETS];
+int staticAssetCount = 0;
+
+// Bytes compressed at startup so far, beyond MAX_STARTUP_COMPRESSION only precompressed variants are used
+size_t staticCompressedLength = 0;
+bool staticCompressionSkipped = false;
+
 void SIGCHLD_handler(int);
 void install_SIGCHLD_handler(void);
+void SIGUSR1_handler(int);
+void install_SIGUSR1_handler(void);
+void SIGUSR2_handler(int);
+void install_SIGUSR2_handler(void);
 void processClient(int n);
+void processRpcClient(int clientIndex);
+void processWebSocketClient(int clientIndex, const char *key, const char *pending, size_t pendingLength);
+void buildResponseHeader(int statusCode, char *contentType);
+void sendDataToClient(int clientIndex, bool sendPayload, char *file);
+int openTcpListener(const char *port);
+int openUnixListener(const char *path);
+bool isPeerAllowed(int fd);
+void refuseConnection(int clientIndex, bool isRpc, int statusCode, int retryAfter);
+uint64_t rateAddressKey(int fd, const struct sockaddr_storage *address);
+uint64_t rateClock(void);
+bool takeRateToken(uint64_t addressKey, rateClass class, uint64_t now, int *retryAfter);
+void warmUpServer(void);
+void dumpTraceFile(void);
+void setDeadline(struct timespec *deadline, long milliseconds);
+bool deadlineExceeded(const struct timespec *deadline);
+pid_t startNewServer(char **argv, const int *listenerFds, const sigset_t *waitMask, int *readyFd);
+bool isListeningSocket(int fd, int family);
+void abandonNewServer(pid_t pid, int *readyFd);
+void drainClients(const sigset_t *waitMask);
+bool bigDivMod(bigNumber *q, bigNumber *r, const bigNumber *a, const bigNumber *b);
+void insertSketch(quantileSketch *sketch, int level, double value);
 
 int main (int argc, char **argv)
 {
- 	int n, listenfd;
+ 	int n;
 	char c;
 	char strPort[6] = {0, };
+	char *rpcPort = NULL;
+	char *socketPath = NULL;
+	int rpcListener = -1;
+	bool listenTcp = true;
+	struct pollfd listeners[MAX_LISTENERS + 1];
+	int listenerCount = 0;
+	int listenerFds[MAX_LISTENERS] = {-1, -1, -1};
+	int inheritedFds[MAX_LISTENERS] = {-1, -1, -1};
+	char *variable = NULL;
+	sigset_t blockedSignals, waitMask;
 
 	// Converting default port to char array
 	snprintf(strPort, sizeof(strPort), "%d", DEFAULT_PORTNUMBER);
 
   	// Parsing the command line arguments
-    while ((c = getopt(argc, argv, "p:h")) != -1)
+    while ((c = getopt(argc, argv, "p:b:u:a:L:t:nh")) != -1)
 	{
 		if (c == 'h')
 		{
@@ -63,7 +565,23 @@ int main (int argc, char **argv)
 			printf("===========================\n");
 			printf("Usage: $ ./httpcalc                 ... Starts the server at default port %d\n", DEFAULT_PORTNUMBER);
 			printf("       $ ./httpcalc -p <portnumber> ... Starts the server at port <portnumber>\n");
+			printf("       $ ./httpcalc -b <portnumber> ... Serves the binary protocol at port <portnumber>\n");
+			printf("       $ ./httpcalc -u <path>       ... Also listens on the Unix domain socket <path>\n");
+			printf("       $ ./httpcalc -u <path> -n    ... Listens on the Unix domain socket <path> only\n");
+			printf("       $ ./httpcalc -a <uid>        ... Allows user <uid> on the Unix domain socket (root and\n");
+			printf("                                        the user running the server are always allowed)\n");
+			printf("       $ ./httpcalc -L <class>:<rate>:<burst>\n");
+			printf("                                    ... Limits each client address to <rate> requests per second\n");
+			printf("                                        with bursts of <burst> requests for the routes of <class>:\n");
+			printf("                                        static (files), calc, heavy (matrix, stats, big, range,\n");
+			printf("                                        integrate, root, minimize, binary frames and WebSocket\n");
+			printf("                                        messages) or connect (connections). Rate 0 disables the limit.\n");
+			printf("       $ ./httpcalc -t <sampling>   ... Traces every <sampling>-th request, the traces are written\n");
+			printf("                                        to %s on SIGUSR1 or sent by\n", TRACE_FILE_FORMAT);
+			printf("                                        /admin/trace (local clients only) as Chrome trace JSON\n");
 			printf("       $ ./httpcalc -h              ... Prints this help and exits the program\n\n");
+			printf("SIGUSR2 restarts the server binary gracefully: the new process takes over the listening\n");
+			printf("sockets and the old one finishes its connections (at most %d s) before it exits.\n\n", DRAIN_DEADLINE_MS / 1000);
 			exit(0);
 		}
 
@@ -90,20 +608,151 @@ int main (int argc, char **argv)
 			// Convert and override user specified port to char array
 			memset(strPort, 0, sizeof(strPort));
 			snprintf(strPort, sizeof(strPort), "%d", (int)longPort);
+		}
 
-			break;
+		if (c == 'b')
+		{
+			// Validate port
+			long longPort = strtol(optarg, NULL, 10);
+
+			if (strlen(optarg) > 5 || longPort <= 1 || longPort > 65535)
+			{
+				printf("ERROR: Invalid port number %s!\n\n", optarg);
+				exit(-1);
+			}
+
+			rpcPort = optarg;
+		}
+
+		if (c == 'u')
+		{
+			socketPath = optarg;
+		}
+
+		if (c == 'n')
+		{
+			listenTcp = false;
+		}
+
+		if (c == 'a')
+		{
+			char *end = NULL;
+			long uid = strtol(optarg, &end, 10);
+
+			// Validate user ID
+			if (end == optarg || *end != '\0' || uid < 0 || allowedUserCount == MAX_ALLOWED_USERS)
+			{
+				printf("ERROR: Invalid or too many user IDs %s!\n\n", optarg);
+				exit(-1);
+			}
+
+			allowedUsers[allowedUserCount++] = (uid_t)uid;
+		}
+
+		if (c == 'L')
+		{
+			char name[MAX_URI_LENGTH] = {0, };
+			unsigned int rate = 0, burst = 0;
+			int class = RATE_CLASSES;
+
+			if (sscanf(optarg, "%63[a-z]:%u:%u", name, &rate, &burst) == 3)
+			{
+				for (class = 0; class < RATE_CLASSES && strcmp(name, rateLimits[class].name) != 0; class++);
+			}
+
+			// Validate rate limit
+			if (class == RATE_CLASSES || rate > MAX_RATE || (rate > 0 && (burst < 1 || burst > MAX_RATE_BURST)))
+			{
+				printf("ERROR: Invalid rate limit %s!\n\n", optarg);
+				exit(-1);
+			}
+
+			rateLimits[class].rate = rate;
+			rateLimits[class].burst = burst;
+		}
+
+		if (c == 't')
+		{
+			char *end = NULL;
+			long sampling = strtol(optarg, &end, 10);
+
+			// Validate sampling
+			if (end == optarg || *end != '\0' || sampling < 1 || sampling > INT32_MAX)
+			{
+				printf("ERROR: Invalid trace sampling %s!\n\n", optarg);
+				exit(-1);
+			}
+
+			traceSampling = (int)sampling;
 		}
 
+	}
 
+	if (!listenTcp && socketPath == NULL)
+	{
+		printf("ERROR: -n requires a Unix domain socket (-u <path>)!\n\n");
+		exit(-1);
 	}
 
 	// Init random number generator
 	srand(time(NULL));
 
-	printf("Starting HTTP_Calc Server on port %s...\n", strPort);
+	// The token buckets are shared by all client processes
+	rateTable = mmap(NULL, RATE_TABLE_SIZE * sizeof(rateBucket), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	if (rateTable == MAP_FAILED)
+	{
+		printf("ERROR: Could not create the rate limiting table!\n\n");
+		exit(-1);
+	}
+
+	// The trace ring is shared as well, it only exists with tracing enabled
+	if (traceSampling > 0)
+	{
+		traceTable = mmap(NULL, sizeof(traceBuffer), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+		if (traceTable == MAP_FAILED)
+		{
+			printf("ERROR: Could not create the trace buffer!\n\n");
+			exit(-1);
+		}
+
+		traceTable->serverPid = (int)getpid();
+		printf("Tracing 1 of every %d requests...\n", traceSampling);
+	}
+
+	if (listenTcp)
+	{
+		printf("Starting HTTP_Calc Server on port %s...\n", strPort);
+	}
+
+	if (socketPath != NULL)
+	{
+		printf("Starting HTTP_Calc Server on Unix domain socket %s...\n", socketPath);
+	}
+
+	if (rpcPort != NULL)
+	{
+		printf("Starting binary protocol on port %s...\n", rpcPort);
+	}
 
 	// Establish SIGCHLD signal handler that deals with zombies (by teacher)
 	install_SIGCHLD_handler();
+	install_SIGUSR1_handler();
+
+	// Writing to a connection the client has closed fails with EPIPE instead of killing the process
+	signal(SIGPIPE, SIG_IGN);
+	install_SIGUSR2_handler();
+
+	// The signals are only handled while waiting for connections
+	sigemptyset(&blockedSignals);
+	sigaddset(&blockedSignals, SIGCHLD);
+	sigaddset(&blockedSignals, SIGUSR1);
+	sigaddset(&blockedSignals, SIGUSR2);
+	sigprocmask(SIG_BLOCK, &blockedSignals, &waitMask);
+	sigdelset(&waitMask, SIGCHLD);
+	sigdelset(&waitMask, SIGUSR1);
+	sigdelset(&waitMask, SIGUSR2);
 
 	// Mark all client slots as disconnected by setting them to -1
 	for (n = 0; n < MAX_CLIENTS; n++)
@@ -111,400 +760,6631 @@ int main (int argc, char **argv)
 		clients[n] = -1;
 	}
 
- 	struct addrinfo addrFlags, *returnValue, *pCurrent;
+	// Listening sockets handed over by the previous server on a graceful restart
+	if ((variable = getenv(LISTEN_FDS_VARIABLE)) != NULL)
+	{
+		if (sscanf(variable, "%d,%d,%d", &inheritedFds[0], &inheritedFds[1], &inheritedFds[2]) != MAX_LISTENERS)
+		{
+			printf("ERROR: Invalid %s!\n\n", LISTEN_FDS_VARIABLE);
+			exit(-3);
+		}
 
-    // Prepare getaddrinfo flags
-    memset(&addrFlags, 0, sizeof(struct addrinfo));
-	addrFlags.ai_family = AF_INET;
-    addrFlags.ai_socktype = SOCK_STREAM;
-    addrFlags.ai_flags = AI_PASSIVE;
+		// Descriptors which are not listening sockets are replaced by new listeners
+		for (n = 0; n < MAX_LISTENERS; n++)
+		{
+			if (inheritedFds[n] != -1 && !isListeningSocket(inheritedFds[n], (n == 2) ? AF_UNIX : AF_INET))
+			{
+				printf("ERROR: Inherited descriptor %d is not a listening socket, opening a new one!\n", inheritedFds[n]);
+				inheritedFds[n] = -1;
+			}
+		}
 
-	if (getaddrinfo(NULL, strPort, &addrFlags, &returnValue) != 0)
-    {
-        printf("ERROR: getaddrinfo() error!\n\n");
-        exit(-2);
-    }
+		printf("INFO: Taking over the listening sockets of the previous server.\n");
+		unsetenv(LISTEN_FDS_VARIABLE);
+	}
 
-    // Try to create a socket and bind to it
-    for (pCurrent = returnValue; pCurrent != NULL; pCurrent = pCurrent->ai_next)
-    {
-        listenfd = socket(pCurrent->ai_family, pCurrent->ai_socktype, 0);
+	// Create the TCP listeners
+	if (listenTcp)
+	{
+		if ((listenerFds[0] = inheritedFds[0]) == -1 && (listenerFds[0] = openTcpListener(strPort)) == -1)
+		{
+			exit(-3);
+		}
 
-		if (listenfd == -1)
+		listeners[listenerCount++].fd = listenerFds[0];
+	}
+
+	if (rpcPort != NULL)
+	{
+		if ((listenerFds[1] = inheritedFds[1]) == -1 && (listenerFds[1] = openTcpListener(rpcPort)) == -1)
 		{
-			continue;
+			exit(-3);
 		}
 
-		if (bind(listenfd, pCurrent->ai_addr, pCurrent->ai_addrlen) == 0)
+		rpcListener = listenerFds[1];
+		listeners[listenerCount++].fd = rpcListener;
+	}
+
+	// Create the Unix domain socket listener
+	if (socketPath != NULL)
+	{
+		if ((listenerFds[2] = inheritedFds[2]) == -1 && (listenerFds[2] = openUnixListener(socketPath)) == -1)
 		{
-			break;
+			exit(-3);
 		}
-    }
 
-    if (pCurrent == NULL)
-    {
-        printf("ERROR: Could not create socket or binding!\n\n");
-        exit(-3);
-    }
+		listeners[listenerCount++].fd = listenerFds[2];
+	}
 
-	// Cleanup / free memory
-    freeaddrinfo(returnValue);
+	for (n = 0; n < listenerCount; n++)
+	{
+		listeners[n].events = POLLIN;
+	}
 
-    // listen for incoming connections
-    if (listen(listenfd, MAX_PENDING_CONNECTIONS) == -1)
-    {
-        printf("ERROR: Could not start listening!\n\n");
-        exit(1);
-    }
+	// Fill the caches before taking traffic
+	warmUpServer();
+
+	// Tell the previous server that this one accepts connections now
+	if ((variable = getenv(READY_FD_VARIABLE)) != NULL)
+	{
+		int readyFd = atoi(variable);
+
+		if (write(readyFd, "1", 1) != 1)
+		{
+			printf("ERROR: Could not report readiness to the previous server!\n");
+		}
+
+		close(readyFd);
+		unsetenv(READY_FD_VARIABLE);
+	}
+
+	// Flush the start messages, so the client processes do not repeat them
+	fflush(stdout);
 
-	struct sockaddr_in clientAddr;
+	const struct timespec restartStep = {0, 100000000L};
+	struct sockaddr_storage clientAddr;
+	struct timespec restartDeadline;
 	socklen_t len;
-	int slot = 0;
+	int slot = 0, readyFd = -1, pollCount = 0, retryAfter = 0;
+	pid_t pid, newServerPid = -1;
+	char readyByte = 0;
 
 	// Endless loop
   	while (1)
 	{
-    	len = sizeof(clientAddr);
-
-		// Accept new incoming connection
-		clients[slot] = accept(listenfd, (struct sockaddr *)&clientAddr, &len);
+		// Write the request traces
+		if (traceDumpRequested)
+		{
+			traceDumpRequested = 0;
+			dumpTraceFile();
+		}
 
-		if (clients[slot] < 0)
+		// Graceful restart: start the new server, connections are accepted while it warms up
+		if (restartRequested)
 		{
-            printf("ERROR: Could not accept connection!\n\n");
-			exit(-1);
+			restartRequested = 0;
+
+			if (readyFd == -1 && (newServerPid = startNewServer(argv, listenerFds, &waitMask, &readyFd)) != -1)
+			{
+				setDeadline(&restartDeadline, RESTART_READY_TIMEOUT_MS);
+			}
 		}
-        else
-        {
-            if (fork() == 0)
-            {
-                processClient(slot);
-                exit(0);
-            }
-        }
 
-        while (clients[slot] != -1)
+		if (readyFd != -1 && deadlineExceeded(&restartDeadline))
 		{
-			slot = (slot + 1) % MAX_CLIENTS;
+			abandonNewServer(newServerPid, &readyFd);
 		}
-  	}
-}
 
-char responseHeaderBuffer[MAX_RESPONSE_LENGTH];
-char responsePayloadBuffer[MAX_PAYLOAD_LENGTH];
+		// The readiness pipe of a starting server is polled after the listeners
+		pollCount = listenerCount;
 
-void buildResponseHeader(int statusCode, char *contentType)
-{
-	// Day/Month constants, since asctime returns incorrect format
-	const char daysOfWeek[7][4] = {"Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun"};
-	const char monthsOfYear[12][4] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+		if (readyFd != -1)
+		{
+			listeners[pollCount].fd = readyFd;
+			listeners[pollCount++].events = POLLIN;
+		}
 
-	const char statusCode200[] = "200 OK";
-	const char statusCode400[] = "400 Bad Request";
-	const char statusCode404[] = "404 Not Found";
-	const char statusCode405[] = "405 Method Not Allowed\r\nAllow: GET, HEAD";
-	const char statusCode414[] = "414 Request-URI Too Long";
-	const char statusCode500[] = "500 Internal Server Error";
+		// Wait for incoming connections on all listeners, the signals interrupt ppoll
+		if (ppoll(listeners, pollCount, (readyFd != -1) ? &restartStep : NULL, &waitMask) == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
 
-	char statusCodeBuffer[128] = {0, };
+			printf("ERROR: Could not wait for connections!\n\n");
+			exit(-1);
+		}
 
-	switch (statusCode)
-	{
-		case 200:
-			strncpy(statusCodeBuffer, statusCode200, strlen(statusCode200));
-			break;
+		// The new server is ready: hand the listeners over, stop accepting and finish the connections.
+		// The pipe is closed without the byte if the new server fails.
+		if (readyFd != -1 && listeners[listenerCount].revents != 0)
+		{
+			if (read(readyFd, &readyByte, 1) == 1)
+			{
+				printf("INFO: New server (PID %d) is ready, stopping to accept connections.\n", (int)newServerPid);
+				fflush(stdout);
 
-		case 400:
-			strncpy(statusCodeBuffer, statusCode400, strlen(statusCode400));
-			break;
+				for (n = 0; n < listenerCount; n++)
+				{
+					close(listeners[n].fd);
+				}
 
-		case 404:
-			strncpy(statusCodeBuffer, statusCode404, strlen(statusCode404));
-			break;
+				drainClients(&waitMask);
+				exit(0);
+			}
 
-		case 405:
-			strncpy(statusCodeBuffer, statusCode405, strlen(statusCode405));
-			break;
+			abandonNewServer(newServerPid, &readyFd);
+		}
 
-		case 414:
-			strncpy(statusCodeBuffer, statusCode414, strlen(statusCode414));
-			break;
+		for (n = 0; n < listenerCount; n++)
+		{
+			if ((listeners[n].revents & POLLIN) == 0)
+			{
+				continue;
+			}
 
-		case 500:
-			strncpy(statusCodeBuffer, statusCode500, strlen(statusCode500));
-			break;
+			len = sizeof(clientAddr);
 
-		default:
-			return;
-			break;
-	}
+			// Accept new incoming connection
+			clients[slot] = accept(listeners[n].fd, (struct sockaddr *)&clientAddr, &len);
 
-	// Get current time
-	struct tm *GMT;
-	time_t now;
+			if (clients[slot] < 0)
+			{
+				if (errno == EINTR || errno == ECONNABORTED)
+				{
+					clients[slot] = -1;
+					continue;
+				}
 
-	time(&now);
+				printf("ERROR: Could not accept connection!\n\n");
+				exit(-1);
+			}
 
-	// Get GMT time from current time
-	GMT = gmtime(&now);
+			// A child outside the process table could not be drained or terminated on restart
+			if (clientProcessCount >= MAX_CLIENT_PROCESSES)
+			{
+				printf("ERROR: Too many client processes (%d), refusing connection!\n", MAX_CLIENT_PROCESSES);
+				refuseConnection(slot, listeners[n].fd == rpcListener, 503, 1);
+				continue;
+			}
 
-	// Clear response buffers
-	memset((void *)responseHeaderBuffer,  0, MAX_RESPONSE_LENGTH);
-	memset((void *)responsePayloadBuffer, 0, MAX_PAYLOAD_LENGTH);
+			// Limit the connections of the client address on all listeners
+			clientRateKey = rateAddressKey(clients[slot], &clientAddr);
 
-	// Create HTTP client response
-	snprintf(responseHeaderBuffer, MAX_RESPONSE_LENGTH, "HTTP/1.1 %s\r\nContent-Type: %s; charset=utf-8\r\nCache-Control: no-cache\r\nDate: %.3s, %02d %.3s %d %02d:%02d:%02d GMT\r\nServer: KnoblHyperActiveServer(1.0)\r\nConnection: close\r\n",
-			 statusCodeBuffer, contentType, daysOfWeek[GMT->tm_wday], GMT->tm_mday, monthsOfYear[GMT->tm_mon], GMT->tm_year + 1900, GMT->tm_hour, GMT->tm_min, GMT->tm_sec);
-}
+			if (!takeRateToken(clientRateKey, RATE_CLASS_CONNECT, rateClock(), &retryAfter))
+			{
+				printf("INFO: Connection rate limit exceeded, refusing connection!\n");
+				refuseConnection(slot, listeners[n].fd == rpcListener, 429, retryAfter);
+				continue;
+			}
 
-void appendContentLength(int contentLength)
-{
-	char contentLengthBuffer[MAX_CONTENT_LENGTH_BUFFER] = {0, };
+			if ((pid = fork()) == 0)
+			{
+				bool isRpc = (listeners[n].fd == rpcListener);
 
-	// Build content length buffer
-	snprintf(contentLengthBuffer, MAX_CONTENT_LENGTH_BUFFER, "Content-Length: %d\r\n\r\n", contentLength);
+				// The child only serves the accepted connection
+				for (n = 0; n < pollCount; n++)
+				{
+					close(listeners[n].fd);
+				}
 
-	// Append content length to the header
-    strncpy(&responseHeaderBuffer[strlen(responseHeaderBuffer)], contentLengthBuffer, strlen(contentLengthBuffer));
+				sigprocmask(SIG_UNBLOCK, &blockedSignals, NULL);
+				clientAddress = clientAddr;
+
+				// Check the credentials of Unix domain socket peers
+				if (clientAddr.ss_family == AF_UNIX && !isPeerAllowed(clients[slot]))
+				{
+					buildResponseHeader(403, "text/html");
+					sendDataToClient(slot, true, NULL);
+				}
+				else if (isRpc)
+				{
+					processRpcClient(slot);
+				}
+				else
+				{
+					processClient(slot);
+				}
+
+				exit(0);
+			}
+
+			if (pid == -1)
+			{
+				printf("ERROR: Could not fork client process!\n");
+			}
+			else
+			{
+				clientProcesses[clientProcessCount++] = pid;
+			}
+
+			// The child owns the connection now, free the slot
+			close(clients[slot]);
+			clients[slot] = -1;
+		}
+
+		while (clients[slot] != -1)
+		{
+			slot = (slot + 1) % MAX_CLIENTS;
+		}
+  	}
 }
 
-void printResponseHeaderBuffer()
+// Creates a listening TCP socket at port. Returns the socket or -1 on error.
+int openTcpListener(const char *port)
 {
-	printf("------HTTP RESPONSE------\n");
+	struct addrinfo addrFlags, *returnValue, *pCurrent;
+	int listenfd = -1;
 
-	if (write(STDOUT_FILENO, responseHeaderBuffer, strlen(responseHeaderBuffer)) == -1)
+	// Prepare getaddrinfo flags
+	memset(&addrFlags, 0, sizeof(struct addrinfo));
+	addrFlags.ai_family = AF_INET;
+	addrFlags.ai_socktype = SOCK_STREAM;
+	addrFlags.ai_flags = AI_PASSIVE;
+
+	if (getaddrinfo(NULL, port, &addrFlags, &returnValue) != 0)
 	{
-		perror ("ERROR: Error writing to screen!\n\n");
-		exit(EXIT_FAILURE);
+		printf("ERROR: getaddrinfo() error!\n\n");
+		return -1;
 	}
-}
 
-void closeConnection(int clientIndex)
-{
-    // Close SOCKET
-    if (shutdown(clients[clientIndex], SHUT_RDWR) == -1)
+	// Try to create a socket and bind to it
+	for (pCurrent = returnValue; pCurrent != NULL; pCurrent = pCurrent->ai_next)
 	{
-		printf("ERROR: Could not shutdown client socket!\n");
+		listenfd = socket(pCurrent->ai_family, pCurrent->ai_socktype, 0);
+
+		if (listenfd == -1)
+		{
+			continue;
+		}
+
+		if (bind(listenfd, pCurrent->ai_addr, pCurrent->ai_addrlen) == 0)
+		{
+			break;
+		}
+
+		close(listenfd);
 	}
 
-    if (close(clients[clientIndex]) == -1)
+	// Cleanup / free memory
+	freeaddrinfo(returnValue);
+
+	if (pCurrent == NULL)
 	{
-		printf("ERROR: Could not close client socket!\n");
+		printf("ERROR: Could not create socket or binding!\n\n");
+		return -1;
 	}
 
-    clients[clientIndex] = -1;
+	// listen for incoming connections
+	if (listen(listenfd, MAX_PENDING_CONNECTIONS) == -1)
+	{
+		printf("ERROR: Could not start listening!\n\n");
+		close(listenfd);
+		return -1;
+	}
+
+	return listenfd;
 }
 
-// This function appends the content length property to the header.
-// It sends the header and also the payload if required and available to the client.
-// Finally, the connection gets closed and the client freed.
-void sendDataToClient(int clientIndex, bool sendPayload, char *file)
+// Creates a listening Unix domain stream socket at path, replacing a socket file left
+// behind by a previous run. Access is checked per connection with SO_PEERCRED, so the
+// socket file itself is writable for everyone. Returns the socket or -1 on error.
+int openUnixListener(const char *path)
 {
-	if (file != NULL)
-	{
-		// Send a file
-		int fd = 0;
-		char fileName[MAX_PATH_LENGTH] = {0, };
-		char *rootDirectory;
+	struct sockaddr_un address;
+	struct stat fileStatus;
+	int fd;
 
-		// Get the root directory
-		rootDirectory = getenv("PWD");
+	if (strlen(path) >= sizeof(address.sun_path))
+	{
+		printf("ERROR: Unix domain socket path %s is too long!\n\n", path);
+		return -1;
+	}
 
-		// Check root directory
-		if (rootDirectory == NULL)
-		{
-			printf("ERROR: Could not get root directory!\n");
-			closeConnection(clientIndex);
-			return;
-		}
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
 
-		// Get the absolute location to the file name
-		strncpy(fileName, rootDirectory, strlen(rootDirectory));
-		strncpy(&fileName[strlen(rootDirectory)], file, strlen(file));
+	// Remove a stale socket file, but never other files
+	if (lstat(path, &fileStatus) == 0 && S_ISSOCK(fileStatus.st_mode))
+	{
+		unlink(path);
+	}
 
-		printf("INFO: Client requested file: %s\n", fileName);
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+	{
+		printf("ERROR: Could not create Unix domain socket!\n\n");
+		return -1;
+	}
 
-		// Open the file if it exists
-		if ((fd = open(fileName, O_RDONLY)) != -1)
-		{
-			off_t fsize;
-			int bytesRead = 0;
+	if (bind(fd, (struct sockaddr *)&address, sizeof(address)) == -1 || chmod(path, 0666) == -1)
+	{
+		printf("ERROR: Could not bind Unix domain socket %s!\n\n", path);
+		close(fd);
+		return -1;
+	}
 
-			// Get file length
-			fsize = lseek(fd, 0, SEEK_END);
+	if (listen(fd, MAX_PENDING_CONNECTIONS) == -1)
+	{
+		printf("ERROR: Could not start listening on Unix domain socket!\n\n");
+		close(fd);
+		return -1;
+	}
 
-			// Check file length
-			if (fsize == -1)
-			{
-				printf("ERROR: File size error!\n");
-				closeConnection(clientIndex);
-				return;
-			}
-			else
-			{
-				// Seek to the beginning of the file
-				lseek(fd, 0, SEEK_SET);
-			}
+	return fd;
+}
 
-			// Check file extension and build content type
-		    char *fileExtension = NULL;
-			char contentTypeBuffer[MAX_CONTENT_TYPE_LENGTH] = "text/html";
+// Checks the credentials of a Unix domain socket peer: root, the user running the server
+// and the users given with -a are allowed
+bool isPeerAllowed(int fd)
+{
+	struct ucred credentials;
+	socklen_t length = sizeof(credentials);
+	int n;
 
-			fileExtension = strrchr(fileName, '.');
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == -1)
+	{
+		printf("ERROR: Could not get the credentials of the Unix domain socket peer!\n");
+		return false;
+	}
 
-			// File extension not found?
-			if (fileExtension == NULL)
-			{
-				printf("ERROR: File extension not found!\n");
-			}
-			else
-			{
-				// Compare file extension and set the content type
-				if (strncmp(fileExtension, ".ico", 4) == 0)
-				{
-					memset(contentTypeBuffer, 0, MAX_CONTENT_TYPE_LENGTH);
-					memcpy(contentTypeBuffer, "image/x-icon", sizeof("image/x-icon"));
-				}
-			}
+	if (credentials.uid == 0 || credentials.uid == geteuid())
+	{
+		return true;
+	}
 
-			// Build response
-			buildResponseHeader(200, contentTypeBuffer);
+	for (n = 0; n < allowedUserCount; n++)
+	{
+		if (credentials.uid == allowedUsers[n])
+		{
+			return true;
+		}
+	}
 
-			// Add Content Length parameter
-			if (sendPayload)
-			{
-				appendContentLength(fsize);
-			}
-			else
-			{
-				appendContentLength(0);
-			}
+	printf("ERROR: Unix domain socket peer (PID %d, UID %d) is not allowed!\n", (int)credentials.pid, (int)credentials.uid);
 
-			printResponseHeaderBuffer();
+	return false;
+}
 
-			// Send response header buffer to client
-			if (write(clients[clientIndex], responseHeaderBuffer, strlen(responseHeaderBuffer)) == strlen(responseHeaderBuffer))
-			{
-				printf("INFO: Response header sent OK!\n");
-			}
-			else
-			{
-				printf("ERROR: Failed sending response header to client!\n");
-				closeConnection(clientIndex);
-				return;
-			}
+// Starts a new instance of the server binary, which inherits the listening sockets, warms up and
+// reports its readiness through a pipe. Returns the process ID and the read end of the pipe in
+// readyFd, the caller keeps on serving until the byte arrives. Returns -1 on error.
+pid_t startNewServer(char **argv, const int *listenerFds, const sigset_t *waitMask, int *readyFd)
+{
+	int readyPipe[2];
+	char value[MAX_URI_LENGTH];
+	pid_t pid;
 
-			if (sendPayload)
-			{
-				// Clear payload buffer
-				memset((void *)&responsePayloadBuffer, 0, MAX_PAYLOAD_LENGTH);
+	printf("INFO: Starting new server %s...\n", argv[0]);
 
-				// Read the file until end
-				while ((bytesRead = read(fd, responsePayloadBuffer, MAX_PAYLOAD_LENGTH)) > 0)
-				{
-					// Send payload response buffer to client
-					if (write(clients[clientIndex], responsePayloadBuffer, bytesRead) != bytesRead)
-					{
-						printf("ERROR: Error sending file fragment to client!\n");
+	if (pipe(readyPipe) == -1)
+	{
+		printf("ERROR: Could not create the readiness pipe!\n");
+		return -1;
+	}
 
-						// Close the file
-						if (close(fd) == -1)
-						{
-							printf("ERROR: Could not close the file!\n");
-						}
+	fflush(stdout);
 
-						// Close connection
-						closeConnection(clientIndex);
+	if ((pid = fork()) == 0)
+	{
+		// Pass the listeners and the write end of the pipe in the environment
+		close(readyPipe[0]);
 
-						return;
-					}
-				}
-			}
+		snprintf(value, sizeof(value), "%d,%d,%d", listenerFds[0], listenerFds[1], listenerFds[2]);
+		setenv(LISTEN_FDS_VARIABLE, value, 1);
+		snprintf(value, sizeof(value), "%d", readyPipe[1]);
+		setenv(READY_FD_VARIABLE, value, 1);
 
-			// Close the file
-			if (close(fd) == -1)
-			{
-				printf("ERROR: Could not close the file!\n");
-			}
-        }
-		else
-		{
-			printf("ERROR: File not found!\n");
+		sigprocmask(SIG_SETMASK, waitMask, NULL);
+		execvp(argv[0], argv);
 
-			// Overwrite current built response and build a new one for 404
-			buildResponseHeader(404, "text/html");
+		printf("ERROR: Could not execute %s!\n", argv[0]);
+		fflush(stdout);
+		_exit(1);
+	}
 
-			// Recursive call to send 404
-			sendDataToClient(clientIndex, false, NULL);
+	close(readyPipe[1]);
 
-			return;
-		}
-	}
-	else
+	if (pid == -1)
 	{
-		// Send the custom template
-		// Append Content Length property
-		appendContentLength(strlen(responsePayloadBuffer));
+		printf("ERROR: Could not fork the new server!\n");
+		close(readyPipe[0]);
+		return -1;
+	}
 
-		printResponseHeaderBuffer();
+	*readyFd = readyPipe[0];
 
-		// Send response header buffer to client
-		if (write(clients[clientIndex], responseHeaderBuffer, strlen(responseHeaderBuffer)) > 0)
-		{
-			if (sendPayload && strlen(responsePayloadBuffer) > 0)
-			{
-				// Send payload response buffer to client
-				if (write(clients[clientIndex], responsePayloadBuffer, strlen(responsePayloadBuffer)) == strlen(responsePayloadBuffer))
-				{
-					printf("INFO: Data sent to client OK!\n");
-				}
-				else
-				{
-					printf("ERROR: Error sending Payload to client!\n");
-				}
-			}
-		}
-		else
-		{
-			printf("ERROR: Error sending Header to client!\n");
-		}
-	}
+	return pid;
+}
 
-	// Close connection
-	closeConnection(clientIndex);
+// Stops a new server which did not get ready in time, the old one keeps on serving
+void abandonNewServer(pid_t pid, int *readyFd)
+{
+	printf("ERROR: New server did not get ready, the old one keeps on serving!\n");
+	fflush(stdout);
+
+	kill(pid, SIGTERM);
+	close(*readyFd);
+	*readyFd = -1;
 }
 
-bool convertToDouble(char *input, double *result)
+// Checks that an inherited descriptor is a listening stream socket of the address family
+bool isListeningSocket(int fd, int family)
 {
-	char *strEnd = NULL;
+	struct sockaddr_storage address;
+	socklen_t length = sizeof(int);
+	int accepting = 0, type = 0;
 
-	*result = strtod(input, &strEnd);
+	if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &accepting, &length) == -1 || !accepting)
+	{
+		return false;
+	}
 
-	// Check conversion
-	if (input == strEnd || *strEnd != '\0')
+	length = sizeof(int);
+
+	if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &length) == -1 || type != SOCK_STREAM)
 	{
 		return false;
 	}
-	else
+
+	length = sizeof(address);
+
+	if (getsockname(fd, (struct sockaddr *)&address, &length) == -1)
 	{
-		return true;
+		return false;
 	}
+
+	return (family == AF_UNIX) ? address.ss_family == AF_UNIX : (address.ss_family == AF_INET || address.ss_family == AF_INET6);
 }
 
-// Process client connection
-void processClient(int clientIndex)
+// Waits until the client processes finished their connections, those still running at the
+// deadline are terminated
+void drainClients(const sigset_t *waitMask)
 {
-    char *requestMethod, *requestURL, *protocolVersion;
-	char clientRequestBuffer[MAX_REQUEST_LENGTH] = {0, };
-	int n = 0, bytesRead = 0;
-	bool sendPayload = false;
+	const struct timespec step = {0, 100000000L};
+	struct timespec deadline;
+	int n;
 
-	// Receive client request
-    bytesRead = recv(clients[clientIndex], clientRequestBuffer, MAX_REQUEST_LENGTH, 0);
+	printf("INFO: Draining %d connections...\n", clientProcessCount);
+	setDeadline(&deadline, DRAIN_DEADLINE_MS);
 
-    if (bytesRead < 0)
+	while (clientProcessCount > 0 && !deadlineExceeded(&deadline))
 	{
-        printf("ERROR: Receive error client ID: %d!\n", clientIndex);
+		// SIGCHLD interrupts the wait when a client process finishes
+		ppoll(NULL, 0, &step, waitMask);
+	}
+
+	if (clientProcessCount > 0)
+	{
+		printf("INFO: Terminating %d connections at the drain deadline.\n", clientProcessCount);
+
+		for (n = 0; n < clientProcessCount; n++)
+		{
+			kill(clientProcesses[n], SIGTERM);
+		}
+	}
+
+	printf("INFO: Old server exits.\n");
+}
+
+// Nanoseconds of the monotonic clock
+uint64_t traceClock(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Starts the trace of a request if it is sampled, every traceSampling-th request of all
+// client processes is
+void traceStartRequest(void)
+{
+	traceActive = false;
+
+	if (traceTable == NULL || atomic_fetch_add_explicit(&traceTable->requests, 1, memory_order_relaxed) % traceSampling != 0)
+	{
+		return;
+	}
+
+	currentTrace.pid = (int)getpid();
+	currentTrace.eventCount = 0;
+	currentTrace.url[0] = '\0';
+	currentTrace.start = traceClock();
+	traceActive = true;
+}
+
+// Returns the start time of a phase, without an active trace it costs a single branch
+uint64_t traceBegin(void)
+{
+	return traceActive ? traceClock() : 0;
+}
+
+// Records a phase which started at start
+void traceEnd(tracePhase phase, uint64_t start)
+{
+	traceEvent *event = NULL;
+
+	if (!traceActive || currentTrace.eventCount == MAX_TRACE_EVENTS)
+	{
+		return;
+	}
+
+	event = &currentTrace.events[currentTrace.eventCount++];
+	event->start = start;
+	event->duration = traceClock() - start;
+	event->phase = phase;
+}
+
+// Publishes the trace of the finished request into the next slot of the shared ring
+void traceFinishRequest(void)
+{
+	traceRecord *record = NULL;
+	uint64_t sequence = 0;
+
+	if (!traceActive)
+	{
+		return;
+	}
+
+	traceActive = false;
+	currentTrace.duration = traceClock() - currentTrace.start;
+
+	sequence = atomic_fetch_add_explicit(&traceTable->next, 1, memory_order_relaxed);
+	record = &traceTable->records[sequence % TRACE_SLOTS];
+
+	atomic_store_explicit(&record->sequence, 2 * sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	memcpy(&record->data, &currentTrace, sizeof(traceData));
+	atomic_store_explicit(&record->sequence, 2 * sequence + 2, memory_order_release);
+}
+
+// Maps the address of a client to its rate limiting key, the low byte is left for the route
+// class. Unix domain socket peers are told apart by their user ID. Returns 0 if the client
+// can not be identified, it is not limited then.
+uint64_t rateAddressKey(int fd, const struct sockaddr_storage *address)
+{
+	struct ucred credentials;
+	socklen_t length = sizeof(credentials);
+	const uint8_t *bytes = NULL;
+	uint64_t hash = 14695981039346656037ULL;
+	int n;
+
+	if (address->ss_family == AF_INET)
+	{
+		return (uint64_t)ntohl(((const struct sockaddr_in *)address)->sin_addr.s_addr) << 8;
+	}
+
+	if (address->ss_family == AF_INET6)
+	{
+		// FNV-1a of the IPv6 address, the top bit keeps it apart from the IPv4 addresses
+		bytes = ((const struct sockaddr_in6 *)address)->sin6_addr.s6_addr;
+
+		for (n = 0; n < 16; n++)
+		{
+			hash = (hash ^ bytes[n]) * 1099511628211ULL;
+		}
+
+		return ((hash >> 8) | (1ULL << 55)) << 8;
+	}
+
+	// The user ID of a Unix domain socket peer, the top bits keep it apart from the IP addresses
+	if (address->ss_family == AF_UNIX && getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0)
+	{
+		return ((uint64_t)credentials.uid | (1ULL << 54)) << 8;
+	}
+
+	return 0;
+}
+
+// Checks whether the client is on this host: a Unix domain socket peer or a loopback address
+bool isLocalAddress(const struct sockaddr_storage *address)
+{
+	if (address->ss_family == AF_INET)
+	{
+		return (ntohl(((const struct sockaddr_in *)address)->sin_addr.s_addr) >> 24) == 127;
+	}
+
+	if (address->ss_family == AF_INET6)
+	{
+		return IN6_IS_ADDR_LOOPBACK(&((const struct sockaddr_in6 *)address)->sin6_addr);
+	}
+
+	return address->ss_family == AF_UNIX;
+}
+
+// Rate class of a request URL: static files, simple calculations or the heavy endpoints
+rateClass routeRateClass(const char *url)
+{
+	const char *heavyRoutes[] = {"/calc/matrix", "/calc/stats", "/calc/big", "/calc/range", "/calc/integrate", "/calc/root", "/calc/minimize"};
+	size_t n;
+
+	if (strncmp(url, "/calc/", 6) != 0 && strncmp(url, "/serv/", 6) != 0 && strncmp(url, "/ws\0", 4) != 0)
+	{
+		return RATE_CLASS_STATIC;
+	}
+
+	for (n = 0; n < sizeof(heavyRoutes) / sizeof(heavyRoutes[0]); n++)
+	{
+		if (strncmp(url, heavyRoutes[n], strlen(heavyRoutes[n])) == 0)
+		{
+			return RATE_CLASS_HEAVY;
+		}
+	}
+
+	return RATE_CLASS_CALC;
+}
+
+// Milliseconds of the coarse monotonic clock, which is read without a system call
+uint64_t rateClock(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+	return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// Milli-tokens of a bucket state refilled until now, at most the bucket size
+uint64_t refillRateTokens(uint64_t state, const rateLimit *limit, uint64_t now)
+{
+	uint64_t time = state >> RATE_TOKEN_BITS, tokens = state & ((1ULL << RATE_TOKEN_BITS) - 1);
+	uint64_t full = (uint64_t)limit->burst * 1000;
+
+	// The clock of another process may have been read a little later
+	if (now <= time)
+	{
+		return (tokens < full) ? tokens : full;
+	}
+
+	// Limit the elapsed time, so the product does not overflow
+	if (now - time >= full / limit->rate + 1)
+	{
+		return full;
+	}
+
+	tokens += (now - time) * limit->rate;
+
+	return (tokens < full) ? tokens : full;
+}
+
+// Takes a token from the bucket of the client address and route class. Returns false if the
+// bucket is empty and sets retryAfter to the seconds until the next token then.
+// The table is lock free: a bucket is claimed with a CAS of its key and updated with a CAS of
+// its state. Buckets which are full again are idle, their entries are taken over by new keys
+// when the probed entries are all in use. If there is no entry at all, the client is not limited.
+bool takeRateToken(uint64_t addressKey, rateClass class, uint64_t now, int *retryAfter)
+{
+	const rateLimit *limit = &rateLimits[class];
+	rateBucket *bucket = NULL, *entry = NULL, *idle = NULL;
+	uint64_t key = addressKey | (class + 1), expected = 0, state = 0, desired = 0, tokens = 0;
+	uint64_t index = key;
+	size_t probe;
+
+	if (addressKey == 0 || limit->rate == 0 || rateTable == NULL)
+	{
+		return true;
+	}
+
+	// Mix the key bits (splitmix64 finalizer) for the table index
+	index = (index ^ (index >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	index = (index ^ (index >> 27)) * 0x94D049BB133111EBULL;
+	index ^= index >> 31;
+
+	// Find the bucket of the key or claim a free entry, remember the first idle one
+	for (probe = 0; probe < RATE_TABLE_PROBES && bucket == NULL; probe++)
+	{
+		entry = &rateTable[(index + probe) & (RATE_TABLE_SIZE - 1)];
+		expected = atomic_load_explicit(&entry->key, memory_order_relaxed);
+
+		if (expected == 0 && !atomic_compare_exchange_strong_explicit(&entry->key, &expected, key, memory_order_relaxed, memory_order_relaxed) && expected != key)
+		{
+			continue;
+		}
+
+		if (expected == 0 || expected == key)
+		{
+			bucket = entry;
+		}
+		else if (idle == NULL && refillRateTokens(atomic_load_explicit(&entry->state, memory_order_relaxed), &rateLimits[(expected & 0xFF) - 1], now) == (uint64_t)rateLimits[(expected & 0xFF) - 1].burst * 1000)
+		{
+			idle = entry;
+			desired = expected;
+		}
+	}
+
+	if (bucket == NULL)
+	{
+		// Take over the idle entry, a zero state is a full bucket
+		if (idle == NULL || !atomic_compare_exchange_strong_explicit(&idle->key, &desired, key, memory_order_relaxed, memory_order_relaxed))
+		{
+			return true;
+		}
+
+		bucket = idle;
+		atomic_store_explicit(&bucket->state, 0, memory_order_relaxed);
+	}
+
+	state = atomic_load_explicit(&bucket->state, memory_order_relaxed);
+
+	do
+	{
+		tokens = refillRateTokens(state, limit, now);
+
+		if (tokens < 1000)
+		{
+			*retryAfter = (int)(((1000 - tokens + limit->rate - 1) / limit->rate + 999) / 1000);
+			return false;
+		}
+
+		desired = (now << RATE_TOKEN_BITS) | (tokens - 1000);
+	}
+	while (!atomic_compare_exchange_weak_explicit(&bucket->state, &state, desired, memory_order_relaxed, memory_order_relaxed));
+
+	return true;
+}
+
+char responseHeaderBuffer[MAX_RESPONSE_LENGTH];
+char responsePayloadBuffer[MAX_PAYLOAD_LENGTH];
+
+// Checks whether a content type is text, only text gets a charset parameter
+bool isTextContentType(const char *contentType)
+{
+	return strncmp(contentType, "text/", 5) == 0 || strcmp(contentType, "application/json") == 0 || strcmp(contentType, "application/xml") == 0 ||
+		   strcmp(contentType, "application/javascript") == 0 || strcmp(contentType, "image/svg+xml") == 0;
+}
+
+void buildResponseHeader(int statusCode, char *contentType)
+{
+	// Day/Month constants, since asctime returns incorrect format
+	const char daysOfWeek[7][4] = {"Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun"};
+	const char monthsOfYear[12][4] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+	const char statusCode200[] = "200 OK";
+	const char statusCode400[] = "400 Bad Request";
+	const char statusCode403[] = "403 Forbidden";
+	const char statusCode404[] = "404 Not Found";
+	const char statusCode405[] = "405 Method Not Allowed\r\nAllow: GET, HEAD, POST";
+	const char statusCode408[] = "408 Request Timeout";
+	const char statusCode411[] = "411 Length Required";
+	const char statusCode413[] = "413 Payload Too Large";
+	const char statusCode414[] = "414 Request-URI Too Long";
+	const char statusCode429[] = "429 Too Many Requests";
+	const char statusCode500[] = "500 Internal Server Error";
+	const char statusCode503[] = "503 Service Unavailable";
+
+	char statusCodeBuffer[128] = {0, };
+	uint64_t traceStart = traceBegin();
+
+	switch (statusCode)
+	{
+		case 200:
+			strncpy(statusCodeBuffer, statusCode200, strlen(statusCode200));
+			break;
+
+		case 400:
+			strncpy(statusCodeBuffer, statusCode400, strlen(statusCode400));
+			break;
+
+		case 403:
+			strncpy(statusCodeBuffer, statusCode403, strlen(statusCode403));
+			break;
+
+		case 404:
+			strncpy(statusCodeBuffer, statusCode404, strlen(statusCode404));
+			break;
+
+		case 405:
+			strncpy(statusCodeBuffer, statusCode405, strlen(statusCode405));
+			break;
+
+		case 408:
+			strncpy(statusCodeBuffer, statusCode408, strlen(statusCode408));
+			break;
+
+		case 411:
+			strncpy(statusCodeBuffer, statusCode411, strlen(statusCode411));
+			break;
+
+		case 413:
+			strncpy(statusCodeBuffer, statusCode413, strlen(statusCode413));
+			break;
+
+		case 414:
+			strncpy(statusCodeBuffer, statusCode414, strlen(statusCode414));
+			break;
+
+		case 429:
+			strncpy(statusCodeBuffer, statusCode429, strlen(statusCode429));
+			break;
+
+		case 500:
+			strncpy(statusCodeBuffer, statusCode500, strlen(statusCode500));
+			break;
+
+		case 503:
+			strncpy(statusCodeBuffer, statusCode503, strlen(statusCode503));
+			break;
+
+		default:
+			return;
+			break;
+	}
+
+	// Get current time
+	struct tm *GMT;
+	time_t now;
+
+	time(&now);
+
+	// Get GMT time from current time
+	GMT = gmtime(&now);
+
+	// Clear response buffers
+	memset((void *)responseHeaderBuffer,  0, MAX_RESPONSE_LENGTH);
+	memset((void *)responsePayloadBuffer, 0, MAX_PAYLOAD_LENGTH);
+
+	// Create HTTP client response
+	snprintf(responseHeaderBuffer, MAX_RESPONSE_LENGTH, "HTTP/1.1 %s\r\nContent-Type: %s%s\r\nCache-Control: no-cache\r\nDate: %.3s, %02d %.3s %d %02d:%02d:%02d GMT\r\nServer: KnoblHyperActiveServer(1.0)\r\nConnection: close\r\n",
+			 statusCodeBuffer, contentType, isTextContentType(contentType) ? "; charset=utf-8" : "", daysOfWeek[GMT->tm_wday], GMT->tm_mday, monthsOfYear[GMT->tm_mon], GMT->tm_year + 1900, GMT->tm_hour, GMT->tm_min, GMT->tm_sec);
+
+	traceEnd(TRACE_HEADER, traceStart);
+}
+
+void appendContentLength(int contentLength)
+{
+	char contentLengthBuffer[MAX_CONTENT_LENGTH_BUFFER] = {0, };
+
+	// Build content length buffer
+	snprintf(contentLengthBuffer, MAX_CONTENT_LENGTH_BUFFER, "Content-Length: %d\r\n\r\n", contentLength);
+
+	// Append content length to the header
+    strncpy(&responseHeaderBuffer[strlen(responseHeaderBuffer)], contentLengthBuffer, strlen(contentLengthBuffer));
+}
+
+// Refuses a connection from the main process without forking (a full client process table or
+// the connection rate limit). HTTP clients get the status if it fits into the socket buffer,
+// the main process never blocks.
+void refuseConnection(int clientIndex, bool isRpc, int statusCode, int retryAfter)
+{
+	if (!isRpc)
+	{
+		buildResponseHeader(statusCode, "text/html");
+		snprintf(&responseHeaderBuffer[strlen(responseHeaderBuffer)], MAX_RESPONSE_LENGTH - strlen(responseHeaderBuffer), "Retry-After: %d\r\n", retryAfter);
+		appendContentLength(0);
+		send(clients[clientIndex], responseHeaderBuffer, strlen(responseHeaderBuffer), MSG_DONTWAIT | MSG_NOSIGNAL);
+		shutdown(clients[clientIndex], SHUT_WR);
+
+		// Discard the request received so far, unread data turns the close into a reset
+		while (recv(clients[clientIndex], responsePayloadBuffer, MAX_PAYLOAD_LENGTH, MSG_DONTWAIT) > 0);
+	}
+
+	close(clients[clientIndex]);
+	clients[clientIndex] = -1;
+}
+
+// Terminates the header of a response whose length is not known in advance.
+// HTTP/1.1 clients get a chunked body, HTTP/1.0 clients read until the connection is closed.
+void appendStreamingHeader(bool chunked)
+{
+	const char chunkedHeader[] = "Transfer-Encoding: chunked\r\n\r\n";
+
+	if (chunked)
+	{
+		strcat(responseHeaderBuffer, chunkedHeader);
+	}
+	else
+	{
+		strcat(responseHeaderBuffer, "\r\n");
+	}
+}
+
+void printResponseHeaderBuffer()
+{
+	printf("------HTTP RESPONSE------\n");
+
+	if (write(STDOUT_FILENO, responseHeaderBuffer, strlen(responseHeaderBuffer)) == -1)
+	{
+		perror ("ERROR: Error writing to screen!\n\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void closeConnection(int clientIndex)
+{
+	uint64_t traceStart = traceBegin();
+
+    // Close SOCKET
+    if (shutdown(clients[clientIndex], SHUT_RDWR) == -1)
+	{
+		printf("ERROR: Could not shutdown client socket!\n");
+	}
+
+    if (close(clients[clientIndex]) == -1)
+	{
+		printf("ERROR: Could not close client socket!\n");
+	}
+
+    clients[clientIndex] = -1;
+
+	// The request is finished
+	traceEnd(TRACE_CLOSE, traceStart);
+	traceFinishRequest();
+}
+
+// Writes the whole buffer to the client. The blocking write only returns once the
+// socket accepted the data, so a slow client throttles the producer (backpressure).
+bool writeAllToClient(int clientIndex, const char *buffer, size_t length)
+{
+	ssize_t bytesWritten = 0;
+
+	while (length > 0)
+	{
+		bytesWritten = write(clients[clientIndex], buffer, length);
+
+		if (bytesWritten == -1 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (bytesWritten <= 0)
+		{
+			return false;
+		}
+
+		buffer += bytesWritten;
+		length -= bytesWritten;
+	}
+
+	return true;
+}
+
+// Sends the already built response header and prepares the stream for the body
+bool startResponseStream(responseStream *stream, int clientIndex, bool chunked)
+{
+	stream->clientIndex = clientIndex;
+	stream->chunked = chunked;
+	stream->length = 0;
+
+	// Terminate header
+	appendStreamingHeader(chunked);
+
+	printResponseHeaderBuffer();
+
+	// Send response header buffer to client
+	return writeAllToClient(clientIndex, responseHeaderBuffer, strlen(responseHeaderBuffer));
+}
+
+// Sends the buffered payload as one chunk
+bool flushResponseStream(responseStream *stream)
+{
+	char chunkHeader[MAX_CHUNK_HEADER_LENGTH] = {0, };
+	char *payload = &stream->buffer[MAX_CHUNK_HEADER_LENGTH];
+	int headerLength = 0;
+	bool result = true;
+
+	if (stream->length == 0)
+	{
+		return true;
+	}
+
+	if (stream->chunked)
+	{
+		// Put the chunk size line right in front of the payload and CRLF behind it
+		headerLength = snprintf(chunkHeader, MAX_CHUNK_HEADER_LENGTH, "%zx\r\n", stream->length);
+		memcpy(payload - headerLength, chunkHeader, headerLength);
+		memcpy(payload + stream->length, "\r\n", 2);
+
+		result = writeAllToClient(stream->clientIndex, payload - headerLength, headerLength + stream->length + 2);
+	}
+	else
+	{
+		result = writeAllToClient(stream->clientIndex, payload, stream->length);
+	}
+
+	stream->length = 0;
+
+	return result;
+}
+
+// Appends raw bytes to the stream, flushing full chunks to the client
+bool writeResponseStream(responseStream *stream, const void *data, size_t length)
+{
+	const char *source = data;
+	size_t copyLength = 0;
+
+	while (length > 0)
+	{
+		if (stream->length == MAX_PAYLOAD_LENGTH && !flushResponseStream(stream))
+		{
+			return false;
+		}
+
+		copyLength = MAX_PAYLOAD_LENGTH - stream->length;
+
+		if (copyLength > length)
+		{
+			copyLength = length;
+		}
+
+		memcpy(&stream->buffer[MAX_CHUNK_HEADER_LENGTH + stream->length], source, copyLength);
+		stream->length += copyLength;
+		source += copyLength;
+		length -= copyLength;
+	}
+
+	return true;
+}
+
+// Appends formatted text to the stream. A single formatted piece must fit into MAX_PAYLOAD_LENGTH.
+bool printResponseStream(responseStream *stream, const char *format, ...)
+{
+	va_list arguments;
+	int length = 0;
+
+	va_start(arguments, format);
+	length = vsnprintf(&stream->buffer[MAX_CHUNK_HEADER_LENGTH + stream->length], MAX_PAYLOAD_LENGTH - stream->length, format, arguments);
+	va_end(arguments);
+
+	if (length < 0 || length >= MAX_PAYLOAD_LENGTH)
+	{
+		return false;
+	}
+
+	// Did not fit into the current chunk? Send it and format again into the empty buffer.
+	if ((size_t)length >= MAX_PAYLOAD_LENGTH - stream->length)
+	{
+		if (!flushResponseStream(stream))
+		{
+			return false;
+		}
+
+		va_start(arguments, format);
+		vsnprintf(&stream->buffer[MAX_CHUNK_HEADER_LENGTH], MAX_PAYLOAD_LENGTH, format, arguments);
+		va_end(arguments);
+	}
+
+	stream->length += length;
+
+	return true;
+}
+
+// Sends the remaining payload and the terminating zero length chunk
+bool finishResponseStream(responseStream *stream)
+{
+	if (!flushResponseStream(stream))
+	{
+		return false;
+	}
+
+	if (stream->chunked)
+	{
+		return writeAllToClient(stream->clientIndex, "0\r\n\r\n", 5);
+	}
+
+	return true;
+}
+
+// Returns the MIME type of the file extension or NULL if it is unknown
+const mimeType *findMimeType(const char *fileName)
+{
+	const char *extension = strrchr(fileName, '.');
+	size_t n;
+
+	if (extension == NULL)
+	{
+		return NULL;
+	}
+
+	for (n = 0; n < sizeof(mimeTypes) / sizeof(mimeTypes[0]); n++)
+	{
+		if (strcasecmp(extension, mimeTypes[n].extension) == 0)
+		{
+			return &mimeTypes[n];
+		}
+	}
+
+	return NULL;
+}
+
+// Reads a whole file of at most MAX_STATIC_ASSET_LENGTH bytes into a new buffer
+bool readStaticFile(const char *fileName, char **data, size_t *length)
+{
+	struct stat status;
+	ssize_t bytesRead = 0;
+	size_t total = 0;
+	int fd = open(fileName, O_RDONLY);
+
+	if (fd == -1)
+	{
+		return false;
+	}
+
+	if (fstat(fd, &status) == -1 || !S_ISREG(status.st_mode) || status.st_size > MAX_STATIC_ASSET_LENGTH ||
+		(*data = malloc(status.st_size + 1)) == NULL)
+	{
+		close(fd);
+		return false;
+	}
+
+	while (total < (size_t)status.st_size && (bytesRead = read(fd, *data + total, status.st_size - total)) > 0)
+	{
+		total += bytesRead;
+	}
+
+	close(fd);
+
+	if (total != (size_t)status.st_size)
+	{
+		free(*data);
+		*data = NULL;
+		return false;
+	}
+
+	*length = total;
+
+	return true;
+}
+
+// Compresses data into a new gzip buffer (zlib, best compression)
+bool gzipStaticFile(const char *data, size_t length, char **encoded, size_t *encodedLength)
+{
+	z_stream stream;
+	bool result = false;
+
+	memset(&stream, 0, sizeof(stream));
+
+	// Window bits 15 + 16 select the gzip wrapper
+	if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		return false;
+	}
+
+	*encodedLength = deflateBound(&stream, length);
+
+	if ((*encoded = malloc(*encodedLength)) != NULL)
+	{
+		stream.next_in = (Bytef *)data;
+		stream.avail_in = length;
+		stream.next_out = (Bytef *)*encoded;
+		stream.avail_out = *encodedLength;
+
+		result = (deflate(&stream, Z_FINISH) == Z_STREAM_END);
+		*encodedLength = stream.total_out;
+	}
+
+	deflateEnd(&stream);
+
+	if (!result)
+	{
+		free(*encoded);
+		*encoded = NULL;
+	}
+
+	return result;
+}
+
+// Compresses data into a new brotli buffer (best quality)
+bool brotliStaticFile(const char *data, size_t length, bool text, char **encoded, size_t *encodedLength)
+{
+#ifdef USE_BROTLI
+	*encodedLength = BrotliEncoderMaxCompressedSize(length);
+
+	if (*encodedLength == 0 || (*encoded = malloc(*encodedLength)) == NULL)
+	{
+		return false;
+	}
+
+	if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, text ? BROTLI_MODE_TEXT : BROTLI_MODE_GENERIC,
+							   length, (const uint8_t *)data, encodedLength, (uint8_t *)*encoded))
+	{
+		free(*encoded);
+		*encoded = NULL;
+		return false;
+	}
+
+	return true;
+#else
+	(void)data;
+	(void)length;
+	(void)text;
+	(void)encoded;
+	(void)encodedLength;
+
+	return false;
+#endif
+}
+
+// Loads a file into the static assets. Its gzip and brotli variants are read from <file>.gz and
+// <file>.br if they exist, otherwise they are built for compressible types while the startup
+// compression budget lasts. A variant is only kept if it is smaller than the file.
+void addStaticAsset(const char *root, const char *path)
+{
+	const char suffixes[ENCODINGS][4] = {"", ".gz", ".br"};
+	char fileName[MAX_PATH_LENGTH * 2] = {0, };
+	staticAsset *asset = &staticAssets[staticAssetCount];
+	const mimeType *type = findMimeType(path);
+	bool built = false;
+	int encoding;
+
+	snprintf(fileName, sizeof(fileName), "%s%s", root, path);
+
+	if (strlen(path) >= MAX_PATH_LENGTH || !readStaticFile(fileName, &asset->data[ENCODING_IDENTITY], &asset->length[ENCODING_IDENTITY]))
+	{
+		return;
+	}
+
+	strcpy(asset->path, path);
+	asset->contentType = (type != NULL) ? type->contentType : "text/html";
+
+	for (encoding = ENCODING_GZIP; encoding < ENCODINGS; encoding++)
+	{
+		asset->data[encoding] = NULL;
+		snprintf(fileName, sizeof(fileName), "%s%s%s", root, path, suffixes[encoding]);
+
+		// Precompressed file or a variant built now
+		if (!readStaticFile(fileName, &asset->data[encoding], &asset->length[encoding]) &&
+			type != NULL && type->compressible && asset->length[ENCODING_IDENTITY] >= MIN_COMPRESSED_LENGTH)
+		{
+			// Keep the warm-up short enough for a graceful restart
+			if (staticCompressedLength + asset->length[ENCODING_IDENTITY] > MAX_STARTUP_COMPRESSION)
+			{
+				staticCompressionSkipped = true;
+				continue;
+			}
+
+			staticCompressedLength += asset->length[ENCODING_IDENTITY];
+
+			if (encoding == ENCODING_GZIP)
+			{
+				built = gzipStaticFile(asset->data[ENCODING_IDENTITY], asset->length[ENCODING_IDENTITY], &asset->data[encoding], &asset->length[encoding]);
+			}
+			else
+			{
+				built = brotliStaticFile(asset->data[ENCODING_IDENTITY], asset->length[ENCODING_IDENTITY], strncmp(type->contentType, "image/x-icon", 12) != 0,
+										 &asset->data[encoding], &asset->length[encoding]);
+			}
+
+			if (!built)
+			{
+				asset->data[encoding] = NULL;
+			}
+		}
+
+		if (asset->data[encoding] != NULL && asset->length[encoding] >= asset->length[ENCODING_IDENTITY])
+		{
+			free(asset->data[encoding]);
+			asset->data[encoding] = NULL;
+		}
+	}
+
+	staticAssetCount++;
+}
+
+// Adds the files of the directory root/path and its subdirectories to the static assets.
+// Hidden files and the precompressed variants themselves are skipped.
+void loadStaticDirectory(const char *root, const char *path, int depth)
+{
+	char directoryName[MAX_PATH_LENGTH * 2] = {0, };
+	char entryPath[MAX_PATH_LENGTH] = {0, };
+	struct dirent *entry = NULL;
+	struct stat status;
+	size_t nameLength = 0;
+	DIR *directory = NULL;
+
+	snprintf(directoryName, sizeof(directoryName), "%s%s", root, path);
+
+	if ((directory = opendir(directoryName)) == NULL)
+	{
+		return;
+	}
+
+	while ((entry = readdir(directory)) != NULL && staticAssetCount < MAX_STATIC_ASSETS)
+	{
+		nameLength = strlen(entry->d_name);
+
+		if (entry->d_name[0] == '.' || (nameLength > 3 && (strcmp(&entry->d_name[nameLength - 3], ".gz") == 0 || strcmp(&entry->d_name[nameLength - 3], ".br") == 0)) ||
+			snprintf(entryPath, sizeof(entryPath), "%s/%s", path, entry->d_name) >= (int)sizeof(entryPath))
+		{
+			continue;
+		}
+
+		snprintf(directoryName, sizeof(directoryName), "%s%s", root, entryPath);
+
+		if (stat(directoryName, &status) == -1)
+		{
+			continue;
+		}
+
+		if (S_ISDIR(status.st_mode) && depth < MAX_STATIC_DEPTH)
+		{
+			loadStaticDirectory(root, entryPath, depth + 1);
+		}
+		else if (S_ISREG(status.st_mode))
+		{
+			addStaticAsset(root, entryPath);
+		}
+	}
+
+	closedir(directory);
+}
+
+// Loads the files below the root directory (PWD) with their encoded variants into memory
+void loadStaticAssets(void)
+{
+	size_t lengths[ENCODINGS] = {0, };
+	char *rootDirectory = getenv("PWD");
+	int n, encoding;
+
+	if (rootDirectory == NULL)
+	{
+		printf("ERROR: Could not get root directory!\n");
+		return;
+	}
+
+	loadStaticDirectory(rootDirectory, "", 0);
+
+	for (n = 0; n < staticAssetCount; n++)
+	{
+		for (encoding = 0; encoding < ENCODINGS; encoding++)
+		{
+			lengths[encoding] += (staticAssets[n].data[encoding] != NULL) ? staticAssets[n].length[encoding] : staticAssets[n].length[ENCODING_IDENTITY];
+		}
+	}
+
+	printf("INFO: Loaded %d static files (%zu bytes, %zu with gzip, %zu with brotli).\n", staticAssetCount, lengths[ENCODING_IDENTITY], lengths[ENCODING_GZIP], lengths[ENCODING_BROTLI]);
+
+	if (staticCompressionSkipped)
+	{
+		printf("INFO: Startup compression budget of %d bytes used up, add precompressed files (.gz, .br) for the rest.\n", MAX_STARTUP_COMPRESSION);
+	}
+}
+
+// Parses the Accept-Encoding header into the quality of each encoding in thousandths.
+// Encodings which are not listed get the quality of "*" if present and are refused otherwise.
+// Identity is sent when no other variant is acceptable, unlisted it ranks below everything else.
+void parseAcceptEncoding(const char *header, int qualities[ENCODINGS])
+{
+	char value[MAX_HEADER_VALUE_LENGTH] = {0, };
+	char *token = NULL, *savePointer = NULL, *parameter = NULL;
+	int encoding = 0, quality = 0, wildcard = -1;
+
+	strncpy(value, header, MAX_HEADER_VALUE_LENGTH - 1);
+
+	for (encoding = 0; encoding < ENCODINGS; encoding++)
+	{
+		qualities[encoding] = -1;
+	}
+
+	for (token = strtok_r(value, ",", &savePointer); token != NULL; token = strtok_r(NULL, ",", &savePointer))
+	{
+		while (*token == ' ' || *token == '\t')
+		{
+			token++;
+		}
+
+		if ((parameter = strchr(token, ';')) != NULL)
+		{
+			*parameter++ = '\0';
+		}
+
+		token[strcspn(token, " \t")] = '\0';
+
+		// Quality value (q=0 refuses the encoding)
+		quality = 1000;
+
+		if (parameter != NULL && (parameter = strstr(parameter, "q=")) != NULL)
+		{
+			quality = (int)(strtod(parameter + 2, NULL) * 1000 + 0.5);
+			quality = (quality < 0) ? 0 : (quality > 1000) ? 1000 : quality;
+		}
+
+		if (strcasecmp(token, "gzip") == 0 || strcasecmp(token, "x-gzip") == 0)
+		{
+			encoding = ENCODING_GZIP;
+		}
+		else if (strcasecmp(token, "br") == 0)
+		{
+			encoding = ENCODING_BROTLI;
+		}
+		else if (strcasecmp(token, "identity") == 0)
+		{
+			encoding = ENCODING_IDENTITY;
+		}
+		else if (strcmp(token, "*") == 0)
+		{
+			wildcard = quality;
+			continue;
+		}
+		else
+		{
+			continue;
+		}
+
+		qualities[encoding] = quality;
+	}
+
+	// The wildcard only applies to the encodings which are not listed
+	for (encoding = 0; encoding < ENCODINGS; encoding++)
+	{
+		if (qualities[encoding] < 0)
+		{
+			qualities[encoding] = (wildcard >= 0) ? wildcard : (encoding == ENCODING_IDENTITY) ? 1 : 0;
+		}
+	}
+}
+
+// Sends a static file from memory in the preferred acceptable encoding. Files which are not
+// loaded are read from the disk.
+void sendStaticAsset(int clientIndex, bool sendPayload, char *path, int encodings[ENCODINGS])
+{
+	const char encodingNames[ENCODINGS][8] = {"identity", "gzip", "br"};
+	staticAsset *asset = NULL;
+	uint64_t traceStart = 0;
+	bool hasVariants = false;
+	int n, encoding = ENCODING_IDENTITY;
+
+	for (n = 0; n < staticAssetCount && asset == NULL; n++)
+	{
+		if (strcmp(staticAssets[n].path, path) == 0)
+		{
+			asset = &staticAssets[n];
+		}
+	}
+
+	if (asset == NULL)
+	{
+		sendDataToClient(clientIndex, sendPayload, path);
+		return;
+	}
+
+	printf("INFO: Client requested static file: %s\n", path);
+
+	// Preferred encoding: highest quality, ties go to brotli, then gzip, then identity
+	for (n = ENCODING_IDENTITY + 1; n < ENCODINGS; n++)
+	{
+		hasVariants |= (asset->data[n] != NULL);
+
+		if (asset->data[n] != NULL && encodings[n] > 0 && encodings[n] >= encodings[encoding])
+		{
+			encoding = n;
+		}
+	}
+
+	// Build response
+	buildResponseHeader(200, (char *)asset->contentType);
+	traceStart = traceBegin();
+
+	if (encoding != ENCODING_IDENTITY)
+	{
+		snprintf(&responseHeaderBuffer[strlen(responseHeaderBuffer)], MAX_RESPONSE_LENGTH - strlen(responseHeaderBuffer), "Content-Encoding: %s\r\n", encodingNames[encoding]);
+	}
+
+	// Caches have to keep the variants apart
+	if (hasVariants)
+	{
+		strcat(responseHeaderBuffer, "Vary: Accept-Encoding\r\n");
+	}
+
+	appendContentLength(asset->length[encoding]);
+
+	printResponseHeaderBuffer();
+
+	if (writeAllToClient(clientIndex, responseHeaderBuffer, strlen(responseHeaderBuffer)) &&
+		(!sendPayload || writeAllToClient(clientIndex, asset->data[encoding], asset->length[encoding])))
+	{
+		printf("INFO: Static file sent to client OK (%s)!\n", encodingNames[encoding]);
+	}
+	else
+	{
+		printf("ERROR: Error sending static file to client!\n");
+	}
+
+	traceEnd(TRACE_WRITE, traceStart);
+
+	// Close connection
+	closeConnection(clientIndex);
+}
+
+// This function appends the content length property to the header.
+// It sends the header and also the payload if required and available to the client.
+// Finally, the connection gets closed and the client freed.
+void sendDataToClient(int clientIndex, bool sendPayload, char *file)
+{
+	uint64_t traceStart = traceBegin();
+
+	if (file != NULL)
+	{
+		// Send a file
+		int fd = 0;
+		char fileName[MAX_PATH_LENGTH] = {0, };
+		char *rootDirectory;
+
+		// Get the root directory
+		rootDirectory = getenv("PWD");
+
+		// Check root directory
+		if (rootDirectory == NULL)
+		{
+			printf("ERROR: Could not get root directory!\n");
+			closeConnection(clientIndex);
+			return;
+		}
+
+		// Get the absolute location to the file name
+		strncpy(fileName, rootDirectory, strlen(rootDirectory));
+		strncpy(&fileName[strlen(rootDirectory)], file, strlen(file));
+
+		printf("INFO: Client requested file: %s\n", fileName);
+
+		// Open the file if it exists
+		if ((fd = open(fileName, O_RDONLY)) != -1)
+		{
+			off_t fsize;
+			int bytesRead = 0;
+
+			// Get file length
+			fsize = lseek(fd, 0, SEEK_END);
+
+			// Check file length
+			if (fsize == -1)
+			{
+				printf("ERROR: File size error!\n");
+				closeConnection(clientIndex);
+				return;
+			}
+			else
+			{
+				// Seek to the beginning of the file
+				lseek(fd, 0, SEEK_SET);
+			}
+
+			// Check file extension and build content type
+		    char *fileExtension = NULL;
+			char contentTypeBuffer[MAX_CONTENT_TYPE_LENGTH] = "text/html";
+
+			fileExtension = strrchr(fileName, '.');
+
+			// File extension not found?
+			if (fileExtension == NULL)
+			{
+				printf("ERROR: File extension not found!\n");
+			}
+			else
+			{
+				// Look up the file extension and set the content type
+				const mimeType *type = findMimeType(fileExtension);
+
+				if (type != NULL)
+				{
+					memset(contentTypeBuffer, 0, MAX_CONTENT_TYPE_LENGTH);
+					strncpy(contentTypeBuffer, type->contentType, MAX_CONTENT_TYPE_LENGTH - 1);
+				}
+			}
+
+			// Build response
+			buildResponseHeader(200, contentTypeBuffer);
+
+			// Add Content Length parameter
+			if (sendPayload)
+			{
+				appendContentLength(fsize);
+			}
+			else
+			{
+				appendContentLength(0);
+			}
+
+			printResponseHeaderBuffer();
+
+			// Send response header buffer to client
+			if (write(clients[clientIndex], responseHeaderBuffer, strlen(responseHeaderBuffer)) == strlen(responseHeaderBuffer))
+			{
+				printf("INFO: Response header sent OK!\n");
+			}
+			else
+			{
+				printf("ERROR: Failed sending response header to client!\n");
+				closeConnection(clientIndex);
+				return;
+			}
+
+			if (sendPayload)
+			{
+				// Clear payload buffer
+				memset((void *)&responsePayloadBuffer, 0, MAX_PAYLOAD_LENGTH);
+
+				// Read the file until end
+				while ((bytesRead = read(fd, responsePayloadBuffer, MAX_PAYLOAD_LENGTH)) > 0)
+				{
+					// Send payload response buffer to client
+					if (write(clients[clientIndex], responsePayloadBuffer, bytesRead) != bytesRead)
+					{
+						printf("ERROR: Error sending file fragment to client!\n");
+
+						// Close the file
+						if (close(fd) == -1)
+						{
+							printf("ERROR: Could not close the file!\n");
+						}
+
+						// Close connection
+						closeConnection(clientIndex);
+
+						return;
+					}
+				}
+			}
+
+			// Close the file
+			if (close(fd) == -1)
+			{
+				printf("ERROR: Could not close the file!\n");
+			}
+
+			traceEnd(TRACE_WRITE, traceStart);
+        }
+		else
+		{
+			printf("ERROR: File not found!\n");
+
+			// Overwrite current built response and build a new one for 404
+			buildResponseHeader(404, "text/html");
+
+			// Recursive call to send 404
+			sendDataToClient(clientIndex, false, NULL);
+
+			return;
+		}
+	}
+	else
+	{
+		// Send the custom template
+		// Append Content Length property
+		appendContentLength(strlen(responsePayloadBuffer));
+
+		printResponseHeaderBuffer();
+
+		// Send response header buffer to client
+		if (write(clients[clientIndex], responseHeaderBuffer, strlen(responseHeaderBuffer)) > 0)
+		{
+			if (sendPayload && strlen(responsePayloadBuffer) > 0)
+			{
+				// Send payload response buffer to client
+				if (write(clients[clientIndex], responsePayloadBuffer, strlen(responsePayloadBuffer)) == strlen(responsePayloadBuffer))
+				{
+					printf("INFO: Data sent to client OK!\n");
+				}
+				else
+				{
+					printf("ERROR: Error sending Payload to client!\n");
+				}
+			}
+		}
+		else
+		{
+			printf("ERROR: Error sending Header to client!\n");
+		}
+
+		traceEnd(TRACE_WRITE, traceStart);
+	}
+
+	// Close connection
+	closeConnection(clientIndex);
+}
+
+bool convertToDouble(char *input, double *result)
+{
+	char *strEnd = NULL;
+	uint64_t traceStart = traceBegin();
+
+	*result = strtod(input, &strEnd);
+
+	traceEnd(TRACE_CONVERT, traceStart);
+
+	// Check conversion
+	if (input == strEnd || *strEnd != '\0')
+	{
+		return false;
+	}
+	else
+	{
+		return true;
+	}
+}
+
+// Returns the empty line which ends the request header (CRLF or bare LF line endings) or NULL if
+// it was not received yet. terminatorLength is set to the length of the line breaks.
+char *findHeaderEnd(char *request, size_t *terminatorLength)
+{
+	char *crlf = strstr(request, "\r\n\r\n");
+	char *lf = strstr(request, "\n\n");
+
+	if (lf != NULL && (crlf == NULL || lf < crlf))
+	{
+		*terminatorLength = 2;
+		return lf;
+	}
+
+	*terminatorLength = 4;
+
+	return crlf;
+}
+
+// Copies the value of the request header <name> into value, returns false if the header is missing.
+// Must be called before the request line gets tokenized.
+bool findRequestHeader(const char *request, const char *name, char *value, size_t length)
+{
+	const char *line = strchr(request, '\n');
+	const char *end = NULL;
+	size_t nameLength = strlen(name);
+	size_t valueLength = 0;
+
+	// Walk the header lines until the empty line, the lines may end with CRLF or a bare LF
+	while (line != NULL && line[1] != '\r' && line[1] != '\n' && line[1] != '\0')
+	{
+		line++;
+
+		if (strncasecmp(line, name, nameLength) == 0 && line[nameLength] == ':')
+		{
+			line += nameLength + 1;
+
+			// Skip leading whitespace
+			while (*line == ' ' || *line == '\t')
+			{
+				line++;
+			}
+
+			end = strchr(line, '\n');
+			valueLength = (end == NULL) ? strlen(line) : (size_t)(end - line);
+
+			// Remove trailing whitespace and the CR of the line break
+			while (valueLength > 0 && (line[valueLength - 1] == ' ' || line[valueLength - 1] == '\t' || line[valueLength - 1] == '\r'))
+			{
+				valueLength--;
+			}
+
+			if (valueLength >= length)
+			{
+				valueLength = length - 1;
+			}
+
+			memcpy(value, line, valueLength);
+			value[valueLength] = '\0';
+
+			return true;
+		}
+
+		line = strchr(line, '\n');
+	}
+
+	return false;
+}
+
+// Reads the next line of a chunked request body without the line break.
+// Returns false if the client disconnected or if the line is too long.
+bool readRequestLine(requestBody *body, char *line, size_t length)
+{
+	ssize_t received = 0;
+	size_t n = 0;
+
+	while (true)
+	{
+		// Refill the line buffer from the socket
+		if (body->pendingLength == 0)
+		{
+			do
+			{
+				received = recv(clients[body->clientIndex], body->buffer, MAX_BUFFER_LENGTH, 0);
+			}
+			while (received == -1 && errno == EINTR);
+
+			if (received <= 0)
+			{
+				return false;
+			}
+
+			body->pending = body->buffer;
+			body->pendingLength = received;
+		}
+
+		body->pendingLength--;
+
+		if (*body->pending == '\n')
+		{
+			body->pending++;
+			break;
+		}
+
+		if (n + 1 >= length)
+		{
+			return false;
+		}
+
+		line[n++] = *body->pending++;
+	}
+
+	// Remove the carriage return
+	if (n > 0 && line[n - 1] == '\r')
+	{
+		n--;
+	}
+
+	line[n] = '\0';
+
+	return true;
+}
+
+// Reads the size line of the next chunk. The last chunk has the size 0 and
+// is followed by the (ignored) trailer fields up to an empty line.
+bool readChunkHeader(requestBody *body)
+{
+	char line[MAX_BUFFER_LENGTH];
+	char *end = NULL;
+	long long size = 0;
+
+	// Skip the line break behind the data of the previous chunk
+	do
+	{
+		if (!readRequestLine(body, line, MAX_BUFFER_LENGTH))
+		{
+			return false;
+		}
+	}
+	while (line[0] == '\0');
+
+	errno = 0;
+	size = strtoll(line, &end, 16);
+
+	if (end == line || errno != 0 || size < 0 || (*end != '\0' && *end != ';' && *end != ' ' && *end != '\t'))
+	{
+		return false;
+	}
+
+	if (size == 0)
+	{
+		do
+		{
+			if (!readRequestLine(body, line, MAX_BUFFER_LENGTH))
+			{
+				return false;
+			}
+		}
+		while (line[0] != '\0');
+
+		body->finished = true;
+	}
+
+	body->remaining = size;
+
+	return true;
+}
+
+// Reads up to length bytes of the request body. Returns the number of bytes read,
+// 0 at the end of the body and -1 if the client disconnected too early.
+ssize_t readRequestBody(requestBody *body, void *buffer, size_t length)
+{
+	ssize_t bytesRead = 0;
+
+	// Continue with the next chunk of a chunked body
+	if (body->chunked && body->remaining <= 0 && !body->finished && !readChunkHeader(body))
+	{
+		return -1;
+	}
+
+	if (body->remaining <= 0)
+	{
+		return 0;
+	}
+
+	if ((long long)length > body->remaining)
+	{
+		length = body->remaining;
+	}
+
+	if (body->pendingLength > 0)
+	{
+		// Consume the bytes received together with the header
+		bytesRead = (length < body->pendingLength) ? length : body->pendingLength;
+		memcpy(buffer, body->pending, bytesRead);
+		body->pending += bytesRead;
+		body->pendingLength -= bytesRead;
+	}
+	else
+	{
+		do
+		{
+			bytesRead = recv(clients[body->clientIndex], buffer, length, 0);
+		}
+		while (bytesRead == -1 && errno == EINTR);
+
+		if (bytesRead <= 0)
+		{
+			return -1;
+		}
+	}
+
+	body->remaining -= bytesRead;
+
+	return bytesRead;
+}
+
+// Reads the whole request body into a zero terminated buffer, which has to be freed.
+// Returns false if the client disconnected too early or if out of memory.
+bool readWholeRequestBody(requestBody *body, char **buffer, size_t *length)
+{
+	long long bodyLength = body->remaining;
+	ssize_t bytesRead = 0;
+
+	*length = 0;
+
+	if ((*buffer = malloc(bodyLength + 1)) == NULL)
+	{
+		return false;
+	}
+
+	while ((bytesRead = readRequestBody(body, *buffer + *length, bodyLength - *length)) > 0)
+	{
+		*length += bytesRead;
+	}
+
+	(*buffer)[*length] = '\0';
+
+	if (bytesRead < 0)
+	{
+		free(*buffer);
+		*buffer = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+// Little endian conversion helpers, independent of the host byte order
+uint32_t loadLittleEndian32(const unsigned char *source)
+{
+	return (uint32_t)source[0] | ((uint32_t)source[1] << 8) | ((uint32_t)source[2] << 16) | ((uint32_t)source[3] << 24);
+}
+
+uint64_t loadLittleEndian64(const unsigned char *source)
+{
+	return (uint64_t)loadLittleEndian32(source) | ((uint64_t)loadLittleEndian32(source + 4) << 32);
+}
+
+double loadLittleEndianDouble(const unsigned char *source)
+{
+	uint64_t bits = loadLittleEndian64(source);
+	double result = 0;
+
+	memcpy(&result, &bits, sizeof(result));
+
+	return result;
+}
+
+void storeLittleEndian32(unsigned char *destination, uint32_t value)
+{
+	destination[0] = value & 0xFF;
+	destination[1] = (value >> 8) & 0xFF;
+	destination[2] = (value >> 16) & 0xFF;
+	destination[3] = (value >> 24) & 0xFF;
+}
+
+void storeLittleEndian64(unsigned char *destination, uint64_t value)
+{
+	storeLittleEndian32(destination, (uint32_t)value);
+	storeLittleEndian32(destination + 4, (uint32_t)(value >> 32));
+}
+
+void storeLittleEndianDouble(unsigned char *destination, double value)
+{
+	uint64_t bits = 0;
+
+	memcpy(&bits, &value, sizeof(bits));
+	storeLittleEndian64(destination, bits);
+}
+
+// Number of operands of a scalar operation, 0 for unknown operations
+int operationArity(calcOperation operation)
+{
+	switch (operation)
+	{
+		case OPERATION_ADD:
+		case OPERATION_SUB:
+		case OPERATION_MUL:
+		case OPERATION_DIV:
+		case OPERATION_MOD:
+			return 2;
+
+		case OPERATION_SQRT:
+		case OPERATION_SIN:
+		case OPERATION_COS:
+		case OPERATION_TAN:
+		case OPERATION_RANDOM:
+			return 1;
+	}
+
+	return 0;
+}
+
+// Calculates the operation element by element, result[n] = a[n] <operation> b[n] (b is not used
+// by the unary operations). Each operation has its own loop, so the simple ones vectorize.
+// Elements outside of the domain (division by zero, negative square root) become NaN.
+// Returns the number of these elements.
+size_t calculate(calcOperation operation, const double *a, const double *b, double *result, size_t count)
+{
+	size_t n = 0, errors = 0;
+	uint64_t traceStart = traceBegin();
+
+	switch (operation)
+	{
+		case OPERATION_ADD:
+			for (n = 0; n < count; n++)
+			{
+				result[n] = a[n] + b[n];
+			}
+			break;
+
+		case OPERATION_SUB:
+			for (n = 0; n < count; n++)
+			{
+				result[n] = a[n] - b[n];
+			}
+			break;
+
+		case OPERATION_MUL:
+			for (n = 0; n < count; n++)
+			{
+				result[n] = a[n] * b[n];
+			}
+			break;
+
+		case OPERATION_DIV:
+			for (n = 0; n < count; n++)
+			{
+				errors += (b[n] == 0);
+				result[n] = (b[n] == 0) ? NAN : a[n] / b[n];
+			}
+			break;
+
+		case OPERATION_MOD:
+			// Integer remainder, the operands must fit into an int
+			for (n = 0; n < count; n++)
+			{
+				if (!(fabs(a[n]) < 2147483648.0) || !(fabs(b[n]) < 2147483648.0) || (int)b[n] == 0)
+				{
+					errors++;
+					result[n] = NAN;
+				}
+				else
+				{
+					result[n] = ((int)b[n] == -1) ? 0 : (int)a[n] % (int)b[n];
+				}
+			}
+			break;
+
+		case OPERATION_SQRT:
+			for (n = 0; n < count; n++)
+			{
+				errors += !(a[n] >= 0);
+				result[n] = (a[n] >= 0) ? sqrt(a[n]) : NAN;
+			}
+			break;
+
+		case OPERATION_SIN:
+			for (n = 0; n < count; n++)
+			{
+				result[n] = sin(a[n]);
+			}
+			break;
+
+		case OPERATION_COS:
+			for (n = 0; n < count; n++)
+			{
+				result[n] = cos(a[n]);
+			}
+			break;
+
+		case OPERATION_TAN:
+			for (n = 0; n < count; n++)
+			{
+				result[n] = tan(a[n]);
+			}
+			break;
+
+		case OPERATION_RANDOM:
+			// A random number between 0 and a[n]
+			for (n = 0; n < count; n++)
+			{
+				errors += !(a[n] >= 0);
+				result[n] = (a[n] >= 0) ? ((double)rand() / (double)(RAND_MAX)) * a[n] : NAN;
+			}
+			break;
+
+		default:
+			return count;
+	}
+
+	traceEnd(TRACE_CALCULATE, traceStart);
+
+	return errors;
+}
+
+// Look up a mathematical function by its name, returns NULL if unknown
+mathFunction findMathFunction(const char *name)
+{
+	size_t n;
+
+	for (n = 0; n < sizeof(mathFunctions) / sizeof(mathFunctions[0]); n++)
+	{
+		if (strcmp(mathFunctions[n].name, name) == 0)
+		{
+			return mathFunctions[n].function;
+		}
+	}
+
+	return NULL;
+}
+
+// Evaluates a block of range points. The libm functions are called directly in
+// tight loops (instead of through the pointer), so the compiler is able to
+// vectorize them, e.g. with -O2 -fno-math-errno and the glibc vector math library.
+void evaluateRangeBlock(mathFunction function, double start, double step, long long first, int count, double *x, double *y)
+{
+	int n;
+
+	// Calculate every point from the start, so no rounding error accumulates
+	for (n = 0; n < count; n++)
+	{
+		x[n] = start + (double)(first + n) * step;
+	}
+
+	if (function == sqrt)
+	{
+		for (n = 0; n < count; n++)
+		{
+			y[n] = sqrt(x[n]);
+		}
+	}
+	else if (function == sin)
+	{
+		for (n = 0; n < count; n++)
+		{
+			y[n] = sin(x[n]);
+		}
+	}
+	else if (function == cos)
+	{
+		for (n = 0; n < count; n++)
+		{
+			y[n] = cos(x[n]);
+		}
+	}
+	else if (function == tan)
+	{
+		for (n = 0; n < count; n++)
+		{
+			y[n] = tan(x[n]);
+		}
+	}
+	else
+	{
+		for (n = 0; n < count; n++)
+		{
+			y[n] = function(x[n]);
+		}
+	}
+}
+
+// Streams "x,y" lines of the function values for all points of the range to the client. Points
+// outside the domain of the function (NaN or infinite values) get an empty y field ("x,").
+// Only one block of points and one chunk are held in memory, independent of the point count.
+void sendRangeToClient(int clientIndex, bool sendPayload, bool chunked, mathFunction function, double start, double step, long long count)
+{
+	double x[RANGE_BLOCK_SIZE];
+	double y[RANGE_BLOCK_SIZE];
+	responseStream stream;
+	long long first = 0;
+	int blockCount = 0, n = 0;
+
+	// Build HTTP response
+	buildResponseHeader(200, "text/csv");
+
+	if (!startResponseStream(&stream, clientIndex, chunked))
+	{
+		printf("ERROR: Error sending Header to client!\n");
+		closeConnection(clientIndex);
+		return;
+	}
+
+	if (sendPayload)
+	{
+		for (first = 0; first < count; first += blockCount)
+		{
+			blockCount = (count - first < RANGE_BLOCK_SIZE) ? (int)(count - first) : RANGE_BLOCK_SIZE;
+
+			// Calculate block
+			evaluateRangeBlock(function, start, step, first, blockCount, x, y);
+
+			// Format block
+			for (n = 0; n < blockCount; n++)
+			{
+				if (!(isfinite(y[n]) ? printResponseStream(&stream, "%.17g,%.17g\n", x[n], y[n]) : printResponseStream(&stream, "%.17g,\n", x[n])))
+				{
+					printf("ERROR: Error sending range to client!\n");
+					closeConnection(clientIndex);
+					return;
+				}
+			}
+		}
+
+		if (finishResponseStream(&stream))
+		{
+			printf("INFO: Range of %lld points sent to client OK!\n", count);
+		}
+		else
+		{
+			printf("ERROR: Error sending range to client!\n");
+		}
+	}
+
+	// Close connection
+	closeConnection(clientIndex);
+}
+
+// Copies text into a JSON string, escaping quotes, backslashes and control characters
+void escapeJson(const char *text, char *escaped, size_t size)
+{
+	size_t length = 0;
+
+	for (; *text != '\0' && length + 7 < size; text++)
+	{
+		if (*text == '"' || *text == '\\')
+		{
+			escaped[length++] = '\\';
+			escaped[length++] = *text;
+		}
+		else if ((unsigned char)*text < 0x20)
+		{
+			length += snprintf(&escaped[length], size - length, "\\u%04x", (unsigned int)(unsigned char)*text);
+		}
+		else
+		{
+			escaped[length++] = *text;
+		}
+	}
+
+	escaped[length] = '\0';
+}
+
+// Writes the published request traces as Chrome trace event JSON: a complete event for each
+// request (named by its URL) and its phases, timestamps in microseconds, one thread per client process
+bool writeTrace(traceWriter writer, void *context)
+{
+	const char *phaseNames[TRACE_PHASES] = {"recv", "parse", "route", "convert", "calculate", "header", "format", "write", "close"};
+	const char header[] = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	char line[MAX_TRACE_LINE_LENGTH];
+	char url[MAX_URI_LENGTH * 6];
+	traceRecord *record = NULL;
+	traceData data;
+	uint64_t sequence = 0;
+	bool first = true;
+	size_t slot;
+	int n, length = 0;
+
+	if (!writer(context, header, strlen(header)))
+	{
+		return false;
+	}
+
+	for (slot = 0; slot < TRACE_SLOTS; slot++)
+	{
+		// Copy the slot, it is skipped if a client process writes it meanwhile
+		record = &traceTable->records[slot];
+		sequence = atomic_load_explicit(&record->sequence, memory_order_acquire);
+
+		if (sequence == 0 || (sequence & 1) != 0)
+		{
+			continue;
+		}
+
+		memcpy(&data, &record->data, sizeof(traceData));
+		atomic_thread_fence(memory_order_acquire);
+
+		if (atomic_load_explicit(&record->sequence, memory_order_relaxed) != sequence)
+		{
+			continue;
+		}
+
+		escapeJson(data.url, url, sizeof(url));
+		length = snprintf(line, sizeof(line), "%s\n{\"name\":\"%s\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+						  first ? "" : ",", url, data.start / 1000.0, data.duration / 1000.0, traceTable->serverPid, data.pid);
+		first = false;
+
+		if (!writer(context, line, length))
+		{
+			return false;
+		}
+
+		for (n = 0; n < data.eventCount && n < MAX_TRACE_EVENTS; n++)
+		{
+			length = snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+							  phaseNames[data.events[n].phase], data.events[n].start / 1000.0, data.events[n].duration / 1000.0, traceTable->serverPid, data.pid);
+
+			if (!writer(context, line, length))
+			{
+				return false;
+			}
+		}
+	}
+
+	return writer(context, "\n]}\n", 4);
+}
+
+// Trace writer for a file
+bool writeTraceToFile(void *context, const char *text, size_t length)
+{
+	return fwrite(text, 1, length, (FILE *)context) == length;
+}
+
+// Trace writer for a response stream
+bool writeTraceToStream(void *context, const char *text, size_t length)
+{
+	return writeResponseStream((responseStream *)context, text, length);
+}
+
+// Writes the request traces into TRACE_FILE_FORMAT (on SIGUSR1). The traces go into a new
+// private file which is renamed into place, so a link planted at the path is replaced, not followed.
+void dumpTraceFile(void)
+{
+	char fileName[MAX_PATH_LENGTH] = {0, };
+	char temporaryName[MAX_PATH_LENGTH + 8] = {0, };
+	FILE *file = NULL;
+	bool written = false;
+	int fd = -1;
+
+	if (traceTable == NULL)
+	{
+		printf("ERROR: Tracing is not enabled (-t <sampling>)!\n");
+		return;
+	}
+
+	snprintf(fileName, sizeof(fileName), TRACE_FILE_FORMAT, (int)getpid());
+	snprintf(temporaryName, sizeof(temporaryName), "%s.XXXXXX", fileName);
+
+	// mkstemp creates the file exclusively with mode 0600
+	if ((fd = mkstemp(temporaryName)) == -1 || (file = fdopen(fd, "w")) == NULL)
+	{
+		printf("ERROR: Could not create trace file %s!\n", fileName);
+
+		if (fd != -1)
+		{
+			close(fd);
+			unlink(temporaryName);
+		}
+
+		return;
+	}
+
+	written = writeTrace(writeTraceToFile, file);
+
+	if (fclose(file) != 0 || !written || rename(temporaryName, fileName) == -1)
+	{
+		printf("ERROR: Could not write trace file %s!\n", fileName);
+		unlink(temporaryName);
+		return;
+	}
+
+	printf("INFO: Request traces written to %s.\n", fileName);
+	fflush(stdout);
+}
+
+// Streams the request traces to the client
+void sendTraceToClient(int clientIndex, bool sendPayload, bool chunked)
+{
+	responseStream stream;
+
+	// Build HTTP response
+	buildResponseHeader(200, "application/json");
+
+	if (!startResponseStream(&stream, clientIndex, chunked))
+	{
+		printf("ERROR: Error sending Header to client!\n");
+		closeConnection(clientIndex);
+		return;
+	}
+
+	if (sendPayload)
+	{
+		if (writeTrace(writeTraceToStream, &stream) && finishResponseStream(&stream))
+		{
+			printf("INFO: Request traces sent to client OK!\n");
+		}
+		else
+		{
+			printf("ERROR: Error sending request traces to client!\n");
+		}
+	}
+
+	// Close connection
+	closeConnection(clientIndex);
+}
+
+// Sets the deadline to milliseconds from now on the monotonic clock
+void setDeadline(struct timespec *deadline, long milliseconds)
+{
+	clock_gettime(CLOCK_MONOTONIC, deadline);
+	deadline->tv_sec += milliseconds / 1000;
+	deadline->tv_nsec += (milliseconds % 1000) * 1000000L;
+
+	if (deadline->tv_nsec >= 1000000000L)
+	{
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
+// Checks whether the monotonic clock passed the deadline
+bool deadlineExceeded(const struct timespec *deadline)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+// 15-point Gauss-Kronrod rule with embedded 7-point Gauss rule (QUADPACK qk15).
+// Returns the Kronrod estimate, the difference to the Gauss estimate is the error.
+double gaussKronrod15(mathFunction function, double a, double b, double *error)
+{
+	// Kronrod nodes, odd indices are the Gauss nodes
+	const double nodes[8] = {0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+							 0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+							 0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+							 0.207784955007898467600689403773245, 0.000000000000000000000000000000000};
+	const double kronrodWeights[8] = {0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+									  0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+									  0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+									  0.204432940075298892414161999234649, 0.209482141084727828012999174891714};
+	const double gaussWeights[4] = {0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+									0.381830050505118944950369775488975, 0.417959183673469387755102040816327};
+	double center = 0.5 * (a + b);
+	double halfLength = 0.5 * (b - a);
+	double centerValue = function(center);
+	double kronrod = centerValue * kronrodWeights[7];
+	double gauss = centerValue * gaussWeights[3];
+	double sum = 0;
+	int n;
+
+	for (n = 0; n < 7; n++)
+	{
+		sum = function(center - halfLength * nodes[n]) + function(center + halfLength * nodes[n]);
+		kronrod += kronrodWeights[n] * sum;
+
+		if (n % 2 == 1)
+		{
+			gauss += gaussWeights[n / 2] * sum;
+		}
+	}
+
+	*error = fabs((kronrod - gauss) * halfLength);
+
+	return kronrod * halfLength;
+}
+
+// Adaptive integration, bisects every subinterval whose error estimate is above its tolerance
+double integrateAdaptive(numericTask *task, double a, double b, double tolerance, int depth, double *error)
+{
+	double estimate = 0, leftError = 0, rightError = 0, result = 0;
+	double center = 0.5 * (a + b);
+
+	if (deadlineExceeded(&task->deadline))
+	{
+		task->status = NUMERIC_TIMEOUT;
+		*error = 0;
+		return 0;
+	}
+
+	estimate = gaussKronrod15(task->function, a, b, error);
+
+	if (*error <= tolerance || *error <= NUMERIC_TOLERANCE * fabs(estimate) || depth >= MAX_NUMERIC_DEPTH)
+	{
+		return estimate;
+	}
+
+	result = integrateAdaptive(task, a, center, 0.5 * tolerance, depth + 1, &leftError);
+	result += integrateAdaptive(task, center, b, 0.5 * tolerance, depth + 1, &rightError);
+	*error = leftError + rightError;
+
+	return result;
+}
+
+// Brent's root finding method (zeroin) for a sign change between a and b. A sign change
+// across a pole (e.g. tan at pi/2) converges as well, so the function value at the result
+// must not exceed the values at the ends of the bracket.
+void findRootBrent(numericTask *task)
+{
+	mathFunction f = task->function;
+	double a = task->a, b = task->b, c = 0, d = 0, e = 0;
+	double fa = f(a), fb = f(b), fc = 0;
+	double p = 0, q = 0, r = 0, s = 0, tolerance = 0, middle = 0;
+	double bracketValue = fmax(fabs(fa), fabs(fb));
+	int iteration;
+
+	if ((fa > 0 && fb > 0) || (fa < 0 && fb < 0) || isnan(fa) || isnan(fb))
+	{
+		task->status = NUMERIC_NOT_FOUND;
+		return;
+	}
+
+	c = b;
+	fc = fb;
+
+	for (iteration = 0; iteration < MAX_NUMERIC_ITERATIONS; iteration++)
+	{
+		if (deadlineExceeded(&task->deadline))
+		{
+			task->status = NUMERIC_TIMEOUT;
+			return;
+		}
+
+		// Keep the root bracketed between b and c
+		if ((fb > 0 && fc > 0) || (fb < 0 && fc < 0))
+		{
+			c = a;
+			fc = fa;
+			d = b - a;
+			e = d;
+		}
+
+		// b is always the best estimate
+		if (fabs(fc) < fabs(fb))
+		{
+			a = b;
+			b = c;
+			c = a;
+			fa = fb;
+			fb = fc;
+			fc = fa;
+		}
+
+		tolerance = 2.0 * DBL_EPSILON * fabs(b) + 0.5 * task->tolerance;
+		middle = 0.5 * (c - b);
+
+		if (fabs(middle) <= tolerance || fb == 0)
+		{
+			task->position = b;
+			task->value = fb;
+			task->error = fabs(middle);
+			task->status = (fabs(fb) <= bracketValue) ? NUMERIC_OK : NUMERIC_NOT_FOUND;
+			return;
+		}
+
+		if (fabs(e) >= tolerance && fabs(fa) > fabs(fb))
+		{
+			// Try secant or inverse quadratic interpolation
+			s = fb / fa;
+
+			if (a == c)
+			{
+				p = 2.0 * middle * s;
+				q = 1.0 - s;
+			}
+			else
+			{
+				q = fa / fc;
+				r = fb / fc;
+				p = s * (2.0 * middle * q * (q - r) - (b - a) * (r - 1.0));
+				q = (q - 1.0) * (r - 1.0) * (s - 1.0);
+			}
+
+			if (p > 0)
+			{
+				q = -q;
+			}
+
+			p = fabs(p);
+
+			if (2.0 * p < fmin(3.0 * middle * q - fabs(tolerance * q), fabs(e * q)))
+			{
+				e = d;
+				d = p / q;
+			}
+			else
+			{
+				// Interpolation failed, use bisection
+				d = middle;
+				e = d;
+			}
+		}
+		else
+		{
+			// Bounds decreasing too slowly, use bisection
+			d = middle;
+			e = d;
+		}
+
+		a = b;
+		fa = fb;
+		b += (fabs(d) > tolerance) ? d : copysign(tolerance, middle);
+		fb = f(b);
+	}
+
+	task->status = NUMERIC_NOT_FOUND;
+}
+
+// Brent's minimization method (golden section search with parabolic interpolation)
+void findMinimumBrent(numericTask *task)
+{
+	const double goldenSection = 0.5 * (3.0 - sqrt(5.0));
+	mathFunction f = task->function;
+	double a = task->a, b = task->b, d = 0, e = 0, middle = 0;
+	double p = 0, q = 0, r = 0, tolerance = 0, tolerance2 = 0;
+	double u = 0, v = 0, w = 0, x = 0, fu = 0, fv = 0, fw = 0, fx = 0;
+	int iteration;
+
+	x = w = v = a + goldenSection * (b - a);
+	fx = fw = fv = f(x);
+
+	for (iteration = 0; iteration < MAX_NUMERIC_ITERATIONS; iteration++)
+	{
+		if (deadlineExceeded(&task->deadline))
+		{
+			task->status = NUMERIC_TIMEOUT;
+			return;
+		}
+
+		middle = 0.5 * (a + b);
+		tolerance = sqrt(DBL_EPSILON) * fabs(x) + task->tolerance / 3.0;
+		tolerance2 = 2.0 * tolerance;
+
+		if (fabs(x - middle) <= tolerance2 - 0.5 * (b - a))
+		{
+			break;
+		}
+
+		if (fabs(e) > tolerance)
+		{
+			// Fit parabola through x, v and w
+			r = (x - w) * (fx - fv);
+			q = (x - v) * (fx - fw);
+			p = (x - v) * q - (x - w) * r;
+			q = 2.0 * (q - r);
+
+			if (q > 0)
+			{
+				p = -p;
+			}
+			else
+			{
+				q = -q;
+			}
+
+			r = e;
+			e = d;
+
+			if (fabs(p) >= fabs(0.5 * q * r) || p <= q * (a - x) || p >= q * (b - x))
+			{
+				// Parabola not acceptable, use golden section step
+				e = (x >= middle) ? a - x : b - x;
+				d = goldenSection * e;
+			}
+			else
+			{
+				d = p / q;
+				u = x + d;
+
+				if (u - a < tolerance2 || b - u < tolerance2)
+				{
+					d = copysign(tolerance, middle - x);
+				}
+			}
+		}
+		else
+		{
+			e = (x >= middle) ? a - x : b - x;
+			d = goldenSection * e;
+		}
+
+		u = x + ((fabs(d) >= tolerance) ? d : copysign(tolerance, d));
+		fu = f(u);
+
+		if (fu <= fx)
+		{
+			if (u >= x)
+			{
+				a = x;
+			}
+			else
+			{
+				b = x;
+			}
+
+			v = w;
+			fv = fw;
+			w = x;
+			fw = fx;
+			x = u;
+			fx = fu;
+		}
+		else
+		{
+			if (u < x)
+			{
+				a = u;
+			}
+			else
+			{
+				b = u;
+			}
+
+			if (fu <= fw || w == x)
+			{
+				v = w;
+				fv = fw;
+				w = u;
+				fw = fu;
+			}
+			else if (fu <= fv || v == x || v == w)
+			{
+				v = u;
+				fv = fu;
+			}
+		}
+	}
+
+	task->position = x;
+	task->value = fx;
+	task->error = 0.5 * (b - a);
+	task->status = isnan(fx) ? NUMERIC_NOT_FOUND : NUMERIC_OK;
+
+	// The minimum might lie on the border of the subinterval
+	if (f(task->a) < task->value)
+	{
+		task->position = task->a;
+		task->value = f(task->a);
+	}
+
+	if (f(task->b) < task->value)
+	{
+		task->position = task->b;
+		task->value = f(task->b);
+	}
+}
+
+// Solves one subinterval
+void solveNumericTask(numericTask *task)
+{
+	task->status = NUMERIC_OK;
+
+	switch (task->operation)
+	{
+		case NUMERIC_INTEGRATE:
+			task->value = integrateAdaptive(task, task->a, task->b, task->tolerance, 0, &task->error);
+			break;
+
+		case NUMERIC_ROOT:
+			findRootBrent(task);
+			break;
+
+		case NUMERIC_MINIMIZE:
+			findMinimumBrent(task);
+			break;
+	}
+}
+
+// Thread entry point, solves subintervals until none is left
+void *numericWorker(void *argument)
+{
+	numericQueue *queue = argument;
+	int n;
+
+	while ((n = atomic_fetch_add_explicit(&queue->next, 1, memory_order_relaxed)) < queue->count)
+	{
+		solveNumericTask(&queue->tasks[n]);
+	}
+
+	return NULL;
+}
+
+// Splits the interval [a, b] into NUMERIC_SUBINTERVALS subintervals, solves them in parallel on
+// up to one thread per core and combines the results: the sum of the integrals, the leftmost root
+// or the smallest minimum. The subdivision is fixed, so the result does not depend on the host.
+// Returns the HTTP status code: 200 on success, 500 if there is no result, 503 on deadline.
+int solveNumeric(numericOperation operation, mathFunction function, double a, double b, double *position, double *value, double *error)
+{
+	numericTask tasks[NUMERIC_SUBINTERVALS];
+	pthread_t threads[MAX_NUMERIC_THREADS];
+	bool threadStarted[MAX_NUMERIC_THREADS] = {false, };
+	numericQueue queue = {tasks, NUMERIC_SUBINTERVALS, 0};
+	struct timespec deadline;
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	int count = NUMERIC_SUBINTERVALS, threadCount = 0, n = 0, best = -1;
+	bool timeout = false;
+	double width = (b - a) / count;
+
+	threadCount = (cores < 1) ? 1 : ((cores > MAX_NUMERIC_THREADS) ? MAX_NUMERIC_THREADS : (int)cores);
+	threadCount = (threadCount > count) ? count : threadCount;
+
+	// Compute deadline
+	setDeadline(&deadline, NUMERIC_DEADLINE_MS);
+
+	for (n = 0; n < count; n++)
+	{
+		tasks[n].operation = operation;
+		tasks[n].function = function;
+		tasks[n].a = a + n * width;
+		tasks[n].b = (n == count - 1) ? b : a + (n + 1) * width;
+		tasks[n].tolerance = NUMERIC_TOLERANCE * ((operation == NUMERIC_INTEGRATE) ? 1.0 / count : fmax(1.0, fabs(tasks[n].a)));
+		tasks[n].deadline = deadline;
+		tasks[n].position = 0;
+		tasks[n].value = 0;
+		tasks[n].error = 0;
+	}
+
+	// Start the workers, the calling thread is one of them
+	for (n = 1; n < threadCount; n++)
+	{
+		threadStarted[n] = (pthread_create(&threads[n], NULL, numericWorker, &queue) == 0);
+	}
+
+	numericWorker(&queue);
+
+	for (n = 1; n < threadCount; n++)
+	{
+		if (threadStarted[n])
+		{
+			pthread_join(threads[n], NULL);
+		}
+	}
+
+	// Combine the results
+	*position = 0;
+	*value = 0;
+	*error = 0;
+
+	for (n = 0; n < count; n++)
+	{
+		if (tasks[n].status == NUMERIC_TIMEOUT)
+		{
+			timeout = true;
+		}
+		else if (operation == NUMERIC_INTEGRATE)
+		{
+			*value += tasks[n].value;
+			*error += tasks[n].error;
+		}
+		else if (tasks[n].status == NUMERIC_OK)
+		{
+			if (best == -1 || (operation == NUMERIC_MINIMIZE && tasks[n].value < tasks[best].value))
+			{
+				best = n;
+			}
+		}
+	}
+
+	if (timeout)
+	{
+		printf("ERROR: Numeric operation exceeded the deadline of %d ms!\n", NUMERIC_DEADLINE_MS);
+		return 503;
+	}
+
+	if (operation == NUMERIC_INTEGRATE)
+	{
+		return isfinite(*value) ? 200 : 500;
+	}
+
+	if (best == -1)
+	{
+		return 500;
+	}
+
+	*position = tasks[best].position;
+	*value = tasks[best].value;
+	*error = tasks[best].error;
+
+	return 200;
+}
+
+// Allocates a 64 byte aligned, zero initialized matrix
+bool allocateMatrix(matrix *result, uint32_t rows, uint32_t columns)
+{
+	void *values = NULL;
+	size_t size = (size_t)rows * columns * sizeof(double);
+
+	result->rows = rows;
+	result->columns = columns;
+	result->values = NULL;
+
+	if (rows == 0 || columns == 0 || (size_t)rows * columns > MAX_MATRIX_ELEMENTS)
+	{
+		return false;
+	}
+
+	if (posix_memalign(&values, 64, size) != 0)
+	{
+		return false;
+	}
+
+	memset(values, 0, size);
+	result->values = values;
+
+	return true;
+}
+
+// Parses one CSV matrix (one row per line, values separated by commas). Matrices are separated
+// by an empty line. On success the cursor points behind the matrix.
+bool parseCsvMatrix(char **cursor, matrix *result)
+{
+	char *position = *cursor;
+	char *end = NULL;
+	double *values = NULL, *grown = NULL;
+	size_t count = 0, capacity = 0, rowStart = 0;
+	uint32_t rows = 0, columns = 0;
+
+	// Skip empty lines in front of the matrix
+	while (*position == '\r' || *position == '\n' || *position == ' ' || *position == '\t')
+	{
+		position++;
+	}
+
+	// Read lines until an empty line or the end of the body
+	while (*position != '\0' && *position != '\r' && *position != '\n')
+	{
+		rowStart = count;
+
+		while (true)
+		{
+			// Skip whitespace, but not the line break (strtod would skip it)
+			while (*position == ' ' || *position == '\t')
+			{
+				position++;
+			}
+
+			if (count == capacity)
+			{
+				capacity = (capacity == 0) ? 1024 : capacity * 2;
+
+				if (capacity > MAX_MATRIX_ELEMENTS || (grown = realloc(values, capacity * sizeof(double))) == NULL)
+				{
+					free(values);
+					return false;
+				}
+
+				values = grown;
+			}
+
+			values[count] = strtod(position, &end);
+
+			if (end == position)
+			{
+				free(values);
+				return false;
+			}
+
+			count++;
+			position = end;
+
+			while (*position == ' ' || *position == '\t')
+			{
+				position++;
+			}
+
+			if (*position != ',')
+			{
+				break;
+			}
+
+			position++;
+		}
+
+		// Check end of line and row length
+		if (*position == '\r')
+		{
+			position++;
+		}
+
+		if (*position == '\n')
+		{
+			position++;
+		}
+		else if (*position != '\0')
+		{
+			free(values);
+			return false;
+		}
+
+		if (rows == 0)
+		{
+			columns = count;
+		}
+		else if (count - rowStart != columns)
+		{
+			free(values);
+			return false;
+		}
+
+		rows++;
+	}
+
+	if (rows == 0 || !allocateMatrix(result, rows, columns))
+	{
+		free(values);
+		return false;
+	}
+
+	memcpy(result->values, values, count * sizeof(double));
+	free(values);
+
+	*cursor = position;
+
+	return true;
+}
+
+// Parses one binary matrix: rows and columns as 32 bit little endian integers,
+// followed by rows * columns 64 bit little endian doubles in row-major order.
+bool parseBinaryMatrix(unsigned char **cursor, unsigned char *end, matrix *result)
+{
+	unsigned char *position = *cursor;
+	uint32_t rows = 0, columns = 0;
+	size_t n = 0, count = 0;
+
+	if (end - position < 8)
+	{
+		return false;
+	}
+
+	rows = loadLittleEndian32(position);
+	columns = loadLittleEndian32(position + 4);
+	position += 8;
+
+	if (rows == 0 || columns == 0 || (size_t)rows * columns > MAX_MATRIX_ELEMENTS)
+	{
+		return false;
+	}
+
+	count = (size_t)rows * columns;
+
+	if ((size_t)(end - position) < count * sizeof(double) || !allocateMatrix(result, rows, columns))
+	{
+		return false;
+	}
+
+	for (n = 0; n < count; n++, position += sizeof(double))
+	{
+		result->values[n] = loadLittleEndianDouble(position);
+	}
+
+	*cursor = position;
+
+	return true;
+}
+
+// Dot product with independent partial sums, so the loop vectorizes without reassociation
+double dotProduct(const double *x, const double *y, size_t count)
+{
+	double sums[8] = {0, };
+	double result = 0;
+	size_t n = 0;
+	int lane;
+
+	for (n = 0; n + 8 <= count; n += 8)
+	{
+		for (lane = 0; lane < 8; lane++)
+		{
+			sums[lane] += x[n + lane] * y[n + lane];
+		}
+	}
+
+	for (; n < count; n++)
+	{
+		result += x[n] * y[n];
+	}
+
+	for (lane = 0; lane < 8; lane++)
+	{
+		result += sums[lane];
+	}
+
+	return result;
+}
+
+// Packs a kc x nc block of B into panels of GEMM_NR columns, zero padded
+void packMatrixB(const double *b, int ldb, int kc, int nc, double *packed)
+{
+	int panel, p, j;
+
+	for (panel = 0; panel < nc; panel += GEMM_NR)
+	{
+		for (p = 0; p < kc; p++)
+		{
+			for (j = 0; j < GEMM_NR; j++)
+			{
+				*packed++ = (panel + j < nc) ? b[(size_t)p * ldb + panel + j] : 0.0;
+			}
+		}
+	}
+}
+
+// Packs a mc x kc block of A into panels of GEMM_MR rows, zero padded
+void packMatrixA(const double *a, int lda, int mc, int kc, double *packed)
+{
+	int panel, p, i;
+
+	for (panel = 0; panel < mc; panel += GEMM_MR)
+	{
+		for (p = 0; p < kc; p++)
+		{
+			for (i = 0; i < GEMM_MR; i++)
+			{
+				*packed++ = (panel + i < mc) ? a[(size_t)(panel + i) * lda + p] : 0.0;
+			}
+		}
+	}
+}
+
+// Register tile kernel: adds the product of a packed GEMM_MR x kc panel of A and a packed
+// kc x GEMM_NR panel of B to C. Uses AVX2/FMA if the compiler targets it (e.g. -march=native).
+void multiplyMicroKernel(int kc, const double *a, const double *b, double *c, int ldc, int rows, int columns)
+{
+	double tile[GEMM_MR][GEMM_NR];
+	int p, i, j;
+
+#if defined(__AVX2__) && defined(__FMA__)
+	__m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+	__m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+	__m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+	__m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+	__m256d b0, b1, ai;
+
+	for (p = 0; p < kc; p++, a += GEMM_MR, b += GEMM_NR)
+	{
+		b0 = _mm256_loadu_pd(b);
+		b1 = _mm256_loadu_pd(b + 4);
+
+		ai = _mm256_broadcast_sd(a);
+		c00 = _mm256_fmadd_pd(ai, b0, c00);
+		c01 = _mm256_fmadd_pd(ai, b1, c01);
+
+		ai = _mm256_broadcast_sd(a + 1);
+		c10 = _mm256_fmadd_pd(ai, b0, c10);
+		c11 = _mm256_fmadd_pd(ai, b1, c11);
+
+		ai = _mm256_broadcast_sd(a + 2);
+		c20 = _mm256_fmadd_pd(ai, b0, c20);
+		c21 = _mm256_fmadd_pd(ai, b1, c21);
+
+		ai = _mm256_broadcast_sd(a + 3);
+		c30 = _mm256_fmadd_pd(ai, b0, c30);
+		c31 = _mm256_fmadd_pd(ai, b1, c31);
+	}
+
+	_mm256_storeu_pd(&tile[0][0], c00);
+	_mm256_storeu_pd(&tile[0][4], c01);
+	_mm256_storeu_pd(&tile[1][0], c10);
+	_mm256_storeu_pd(&tile[1][4], c11);
+	_mm256_storeu_pd(&tile[2][0], c20);
+	_mm256_storeu_pd(&tile[2][4], c21);
+	_mm256_storeu_pd(&tile[3][0], c30);
+	_mm256_storeu_pd(&tile[3][4], c31);
+#else
+	memset(tile, 0, sizeof(tile));
+
+	for (p = 0; p < kc; p++, a += GEMM_MR, b += GEMM_NR)
+	{
+		for (i = 0; i < GEMM_MR; i++)
+		{
+			for (j = 0; j < GEMM_NR; j++)
+			{
+				tile[i][j] += a[i] * b[j];
+			}
+		}
+	}
+#endif
+
+	// Only the valid part of the tile is stored
+	for (i = 0; i < rows; i++)
+	{
+		for (j = 0; j < columns; j++)
+		{
+			c[(size_t)i * ldc + j] += tile[i][j];
+		}
+	}
+}
+
+// Thread entry point, multiplies the rows [rowStart, rowEnd) of A with B (cache blocked)
+void *multiplyMatrixWorker(void *argument)
+{
+	matrixTask *task = argument;
+	void *packedA = NULL, *packedB = NULL;
+	int jc, pc, ic, jr, ir, nc, kc, mc;
+
+	if (posix_memalign(&packedA, 64, GEMM_MC * GEMM_KC * sizeof(double)) != 0 ||
+		posix_memalign(&packedB, 64, GEMM_KC * GEMM_NC * sizeof(double)) != 0)
+	{
+		free(packedA);
+		return argument;
+	}
+
+	for (jc = 0; jc < task->n; jc += GEMM_NC)
+	{
+		nc = (task->n - jc < GEMM_NC) ? task->n - jc : GEMM_NC;
+
+		for (pc = 0; pc < task->k; pc += GEMM_KC)
+		{
+			kc = (task->k - pc < GEMM_KC) ? task->k - pc : GEMM_KC;
+
+			// B block stays in L2/L3 cache while all row blocks of A pass by
+			packMatrixB(task->b + (size_t)pc * task->n + jc, task->n, kc, nc, packedB);
+
+			for (ic = task->rowStart; ic < task->rowEnd; ic += GEMM_MC)
+			{
+				mc = (task->rowEnd - ic < GEMM_MC) ? task->rowEnd - ic : GEMM_MC;
+
+				// A block stays in L1/L2 cache while all column panels of B pass by
+				packMatrixA(task->a + (size_t)ic * task->k + pc, task->k, mc, kc, packedA);
+
+				for (jr = 0; jr < nc; jr += GEMM_NR)
+				{
+					for (ir = 0; ir < mc; ir += GEMM_MR)
+					{
+						multiplyMicroKernel(kc, (double *)packedA + (size_t)ir * kc, (double *)packedB + (size_t)jr * kc,
+											task->c + (size_t)(ic + ir) * task->n + jc + jr, task->n,
+											(mc - ir < GEMM_MR) ? mc - ir : GEMM_MR, (nc - jr < GEMM_NR) ? nc - jr : GEMM_NR);
+					}
+				}
+			}
+		}
+	}
+
+	free(packedA);
+	free(packedB);
+
+	return NULL;
+}
+
+// Matrix multiplication C = A * B. Large products are split by rows across the cores.
+bool multiplyMatrix(const matrix *a, const matrix *b, matrix *c)
+{
+	matrixTask tasks[MAX_MATRIX_THREADS];
+	pthread_t threads[MAX_MATRIX_THREADS];
+	bool threadStarted[MAX_MATRIX_THREADS] = {false, };
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	int count = 1, rowsPerTask = 0, n = 0;
+	bool result = true;
+
+	if (!allocateMatrix(c, a->rows, b->columns))
+	{
+		return false;
+	}
+
+	// Matrix-vector product: one dot product per row
+	if (b->columns == 1)
+	{
+		for (n = 0; n < (int)a->rows; n++)
+		{
+			c->values[n] = dotProduct(&a->values[(size_t)n * a->columns], b->values, a->columns);
+		}
+
+		return true;
+	}
+
+	// Use threads for large products only
+	if ((double)a->rows * b->columns * a->columns >= MATRIX_THREAD_THRESHOLD && cores > 1)
+	{
+		count = (cores > MAX_MATRIX_THREADS) ? MAX_MATRIX_THREADS : (int)cores;
+	}
+
+	// Split rows in multiples of the register tile height
+	rowsPerTask = ((a->rows + count - 1) / count + GEMM_MR - 1) / GEMM_MR * GEMM_MR;
+
+	for (n = 0; n < count; n++)
+	{
+		tasks[n].a = a->values;
+		tasks[n].b = b->values;
+		tasks[n].c = c->values;
+		tasks[n].m = a->rows;
+		tasks[n].n = b->columns;
+		tasks[n].k = a->columns;
+		tasks[n].rowStart = (n * rowsPerTask < (int)a->rows) ? n * rowsPerTask : (int)a->rows;
+		tasks[n].rowEnd = ((n + 1) * rowsPerTask < (int)a->rows) ? (n + 1) * rowsPerTask : (int)a->rows;
+	}
+
+	// The first task runs on the calling thread
+	for (n = 1; n < count; n++)
+	{
+		threadStarted[n] = (pthread_create(&threads[n], NULL, multiplyMatrixWorker, &tasks[n]) == 0);
+
+		if (!threadStarted[n] && multiplyMatrixWorker(&tasks[n]) != NULL)
+		{
+			result = false;
+		}
+	}
+
+	if (multiplyMatrixWorker(&tasks[0]) != NULL)
+	{
+		result = false;
+	}
+
+	for (n = 1; n < count; n++)
+	{
+		void *threadResult = NULL;
+
+		if (threadStarted[n])
+		{
+			pthread_join(threads[n], &threadResult);
+
+			if (threadResult != NULL)
+			{
+				result = false;
+			}
+		}
+	}
+
+	return result;
+}
+
+// Calculates the matrix operation <operation> of the operands a and b.
+// Returns the HTTP status code: 200 on success, 400 for mismatching shapes, 404 for unknown operations
+// and 500 if out of memory.
+int calculateMatrix(const char *operation, const matrix *a, const matrix *b, matrix *c)
+{
+	size_t count = (size_t)a->rows * a->columns;
+	size_t n = 0;
+
+	c->values = NULL;
+
+	if (strcmp(operation, "mul") == 0)
+	{
+		if (a->columns != b->rows)
+		{
+			return 400;
+		}
+
+		return multiplyMatrix(a, b, c) ? 200 : 500;
+	}
+
+	if (strcmp(operation, "dot") == 0)
+	{
+		if (count != (size_t)b->rows * b->columns)
+		{
+			return 400;
+		}
+
+		if (!allocateMatrix(c, 1, 1))
+		{
+			return 500;
+		}
+
+		c->values[0] = dotProduct(a->values, b->values, count);
+
+		return 200;
+	}
+
+	if (strcmp(operation, "add") != 0 && strcmp(operation, "sub") != 0 &&
+		strcmp(operation, "emul") != 0 && strcmp(operation, "ediv") != 0)
+	{
+		return 404;
+	}
+
+	// Elementwise operations
+	if (a->rows != b->rows || a->columns != b->columns)
+	{
+		return 400;
+	}
+
+	if (!allocateMatrix(c, a->rows, a->columns))
+	{
+		return 500;
+	}
+
+	if (strcmp(operation, "add") == 0)
+	{
+		for (n = 0; n < count; n++)
+		{
+			c->values[n] = a->values[n] + b->values[n];
+		}
+	}
+	else if (strcmp(operation, "sub") == 0)
+	{
+		for (n = 0; n < count; n++)
+		{
+			c->values[n] = a->values[n] - b->values[n];
+		}
+	}
+	else if (strcmp(operation, "emul") == 0)
+	{
+		for (n = 0; n < count; n++)
+		{
+			c->values[n] = a->values[n] * b->values[n];
+		}
+	}
+	else
+	{
+		for (n = 0; n < count; n++)
+		{
+			c->values[n] = a->values[n] / b->values[n];
+		}
+	}
+
+	return 200;
+}
+
+// Streams the matrix to the client, either as CSV or in the binary operand format
+bool sendMatrixToClient(responseStream *stream, const matrix *result, bool binaryOutput)
+{
+	unsigned char binaryBuffer[8];
+	uint32_t row, column;
+	const double *value = result->values;
+
+	if (binaryOutput)
+	{
+		storeLittleEndian32(binaryBuffer, result->rows);
+		storeLittleEndian32(binaryBuffer + 4, result->columns);
+
+		if (!writeResponseStream(stream, binaryBuffer, 8))
+		{
+			return false;
+		}
+	}
+
+	for (row = 0; row < result->rows; row++)
+	{
+		for (column = 0; column < result->columns; column++, value++)
+		{
+			if (binaryOutput)
+			{
+				storeLittleEndianDouble(binaryBuffer, *value);
+
+				if (!writeResponseStream(stream, binaryBuffer, 8))
+				{
+					return false;
+				}
+			}
+			else if (!printResponseStream(stream, (column + 1 < result->columns) ? "%.17g," : "%.17g\n", *value))
+			{
+				return false;
+			}
+		}
+	}
+
+	return finishResponseStream(stream);
+}
+
+// Reads the two matrix operands from the request body, calculates the operation and streams the result
+void processMatrixRequest(int clientIndex, const char *operation, requestBody *body, bool binaryInput, bool binaryOutput, bool chunked)
+{
+	matrix a = {0, 0, NULL}, b = {0, 0, NULL}, c = {0, 0, NULL};
+	responseStream stream;
+	char *bodyBuffer = NULL, *cursor = NULL;
+	unsigned char *binaryCursor = NULL;
+	size_t offset = 0;
+	int statusCode = 200;
+
+	// Read the whole body, the operands are needed at once. A malformed or incomplete body is
+	// answered with 400 (if the client is still there).
+	if (!readWholeRequestBody(body, &bodyBuffer, &offset))
+	{
+		printf("ERROR: Could not read the request body of client ID: %d!\n", clientIndex);
+
+		// Build HTTP response
+		buildResponseHeader(400, "text/html");
+
+		// Send data
+		sendDataToClient(clientIndex, true, NULL);
+
+		return;
+	}
+
+	// Parse operands
+	if (binaryInput)
+	{
+		binaryCursor = (unsigned char *)bodyBuffer;
+
+		if (!parseBinaryMatrix(&binaryCursor, (unsigned char *)bodyBuffer + offset, &a) ||
+			!parseBinaryMatrix(&binaryCursor, (unsigned char *)bodyBuffer + offset, &b))
+		{
+			statusCode = 400;
+		}
+	}
+	else
+	{
+		cursor = bodyBuffer;
+
+		if (!parseCsvMatrix(&cursor, &a) || !parseCsvMatrix(&cursor, &b))
+		{
+			statusCode = 400;
+		}
+	}
+
+	free(bodyBuffer);
+
+	// Calculate result
+	if (statusCode == 200)
+	{
+		statusCode = calculateMatrix(operation, &a, &b, &c);
+	}
+
+	free(a.values);
+	free(b.values);
+
+	if (statusCode != 200)
+	{
+		free(c.values);
+
+		// Build HTTP response
+		buildResponseHeader(statusCode, "text/html");
+
+		// Send data
+		sendDataToClient(clientIndex, true, NULL);
+
+		return;
+	}
+
+	// Build HTTP response
+	buildResponseHeader(200, binaryOutput ? "application/octet-stream" : "text/csv");
+
+	// Stream the result
+	if (startResponseStream(&stream, clientIndex, chunked) && sendMatrixToClient(&stream, &c, binaryOutput))
+	{
+		printf("INFO: Matrix %ux%u sent to client OK!\n", c.rows, c.columns);
+	}
+	else
+	{
+		printf("ERROR: Error sending matrix to client!\n");
+	}
+
+	free(c.values);
+
+	// Close connection
+	closeConnection(clientIndex);
+}
+
+// Releases the limbs of a number
+void bigFree(bigNumber *x)
+{
+	free(x->limbs);
+	x->limbs = NULL;
+	x->length = 0;
+}
+
+// Allocates a number of length zero limbs
+bool bigAllocate(bigNumber *x, size_t length)
+{
+	x->limbs = calloc(length + 1, sizeof(uint32_t));
+	x->length = length;
+
+	return x->limbs != NULL;
+}
+
+// Removes leading zero limbs
+void bigNormalize(bigNumber *x)
+{
+	while (x->length > 0 && x->limbs[x->length - 1] == 0)
+	{
+		x->length--;
+	}
+}
+
+// Allocates a copy of the limbs
+bool bigCopy(bigNumber *r, const uint32_t *limbs, size_t length)
+{
+	if (!bigAllocate(r, length))
+	{
+		return false;
+	}
+
+	if (length > 0)
+	{
+		memcpy(r->limbs, limbs, length * sizeof(uint32_t));
+	}
+
+	bigNormalize(r);
+
+	return true;
+}
+
+// Compares two limb arrays, returns -1, 0 or 1
+int bigCompareLimbs(const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+	while (an > 0 && a[an - 1] == 0)
+	{
+		an--;
+	}
+
+	while (bn > 0 && b[bn - 1] == 0)
+	{
+		bn--;
+	}
+
+	if (an != bn)
+	{
+		return (an < bn) ? -1 : 1;
+	}
+
+	while (an-- > 0)
+	{
+		if (a[an] != b[an])
+		{
+			return (a[an] < b[an]) ? -1 : 1;
+		}
+	}
+
+	return 0;
+}
+
+int bigCompare(const bigNumber *a, const bigNumber *b)
+{
+	return bigCompareLimbs(a->limbs, a->length, b->limbs, b->length);
+}
+
+// r = a + b with an >= bn, r has an limbs and may be a. Returns the carry.
+uint32_t bigAddLimbs(uint32_t *r, const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+	uint64_t carry = 0;
+	size_t i;
+
+	for (i = 0; i < bn; i++)
+	{
+		carry += (uint64_t)a[i] + b[i];
+		r[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+
+	for (; i < an; i++)
+	{
+		carry += a[i];
+		r[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+
+	return (uint32_t)carry;
+}
+
+// r = a - b with an >= bn, r has an limbs and may be a. Returns the borrow.
+uint32_t bigSubLimbs(uint32_t *r, const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+	uint64_t difference = 0;
+	uint32_t borrow = 0;
+	size_t i;
+
+	for (i = 0; i < bn; i++)
+	{
+		difference = (uint64_t)a[i] - b[i] - borrow;
+		r[i] = (uint32_t)difference;
+		borrow = (difference >> 32) & 1;
+	}
+
+	for (; i < an; i++)
+	{
+		difference = (uint64_t)a[i] - borrow;
+		r[i] = (uint32_t)difference;
+		borrow = (difference >> 32) & 1;
+	}
+
+	return borrow;
+}
+
+// r = a * b, schoolbook multiplication. r has an + bn limbs and must not overlap a or b.
+void bigMulSchoolbook(uint32_t *r, const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+	uint64_t carry = 0;
+	size_t i, j;
+
+	memset(r, 0, (an + bn) * sizeof(uint32_t));
+
+	for (i = 0; i < bn; i++)
+	{
+		if (b[i] == 0)
+		{
+			continue;
+		}
+
+		carry = 0;
+
+		for (j = 0; j < an; j++)
+		{
+			carry += (uint64_t)a[j] * b[i] + r[i + j];
+			r[i + j] = (uint32_t)carry;
+			carry >>= 32;
+		}
+
+		r[i + an] = (uint32_t)carry;
+	}
+}
+
+// r = a * b. r has an + bn limbs and must not overlap a or b.
+// Operands from BIG_KARATSUBA_THRESHOLD limbs on are multiplied with Karatsuba's method:
+// a = a1 * B^h + a0, b = b1 * B^h + b0, a * b = z2 * B^2h + z1 * B^h + z0 with
+// z0 = a0 * b0, z2 = a1 * b1 and z1 = (a0 + a1) * (b0 + b1) - z0 - z2.
+bool bigMulLimbs(uint32_t *r, const uint32_t *a, size_t an, const uint32_t *b, size_t bn)
+{
+	const uint32_t *swap = NULL;
+	uint32_t *scratch = NULL, *sumA = NULL, *sumB = NULL, *middle = NULL;
+	size_t half = 0, sumLength = 0, middleLength = 0, offset = 0, chunk = 0;
+	bool result = true;
+
+	if (an < bn)
+	{
+		swap = a;
+		a = b;
+		b = swap;
+		offset = an;
+		an = bn;
+		bn = offset;
+		offset = 0;
+	}
+
+	if (bn < BIG_KARATSUBA_THRESHOLD)
+	{
+		bigMulSchoolbook(r, a, an, b, bn);
+		return true;
+	}
+
+	half = (an + 1) / 2;
+
+	if (bn <= half)
+	{
+		// Unbalanced operands: multiply b with slices of a of the same size
+		if ((scratch = malloc(2 * bn * sizeof(uint32_t))) == NULL)
+		{
+			return false;
+		}
+
+		memset(r, 0, (an + bn) * sizeof(uint32_t));
+
+		for (offset = 0; offset < an && result; offset += bn)
+		{
+			chunk = (an - offset < bn) ? an - offset : bn;
+			result = bigMulLimbs(scratch, a + offset, chunk, b, bn);
+			bigAddLimbs(r + offset, r + offset, an + bn - offset, scratch, chunk + bn);
+		}
+
+		free(scratch);
+
+		return result;
+	}
+
+	sumLength = half + 1;
+
+	if ((scratch = malloc(4 * sumLength * sizeof(uint32_t))) == NULL)
+	{
+		return false;
+	}
+
+	sumA = scratch;
+	sumB = scratch + sumLength;
+	middle = scratch + 2 * sumLength;
+
+	sumA[half] = bigAddLimbs(sumA, a, half, a + half, an - half);
+	sumB[half] = bigAddLimbs(sumB, b, half, b + half, bn - half);
+
+	// z0 and z2 are stored directly in the result
+	result = bigMulLimbs(r, a, half, b, half) &&
+			 bigMulLimbs(r + 2 * half, a + half, an - half, b + half, bn - half) &&
+			 bigMulLimbs(middle, sumA, sumLength, sumB, sumLength);
+
+	if (result)
+	{
+		middleLength = 2 * sumLength;
+
+		bigSubLimbs(middle, middle, middleLength, r, 2 * half);
+		bigSubLimbs(middle, middle, middleLength, r + 2 * half, an + bn - 2 * half);
+
+		while (middleLength > 0 && middle[middleLength - 1] == 0)
+		{
+			middleLength--;
+		}
+
+		bigAddLimbs(r + half, r + half, an + bn - half, middle, middleLength);
+	}
+
+	free(scratch);
+
+	return result;
+}
+
+// r = a * b
+bool bigMul(bigNumber *r, const bigNumber *a, const bigNumber *b)
+{
+	if (!bigAllocate(r, a->length + b->length))
+	{
+		return false;
+	}
+
+	if (!bigMulLimbs(r->limbs, a->limbs, a->length, b->limbs, b->length))
+	{
+		bigFree(r);
+		return false;
+	}
+
+	bigNormalize(r);
+
+	return true;
+}
+
+// r = a + b
+bool bigAdd(bigNumber *r, const bigNumber *a, const bigNumber *b)
+{
+	const bigNumber *swap = NULL;
+
+	if (a->length < b->length)
+	{
+		swap = a;
+		a = b;
+		b = swap;
+	}
+
+	if (!bigAllocate(r, a->length + 1))
+	{
+		return false;
+	}
+
+	r->limbs[a->length] = bigAddLimbs(r->limbs, a->limbs, a->length, b->limbs, b->length);
+	bigNormalize(r);
+
+	return true;
+}
+
+// r = a - b with a >= b
+bool bigSub(bigNumber *r, const bigNumber *a, const bigNumber *b)
+{
+	if (!bigAllocate(r, a->length))
+	{
+		return false;
+	}
+
+	bigSubLimbs(r->limbs, a->limbs, a->length, b->limbs, b->length);
+	bigNormalize(r);
+
+	return true;
+}
+
+// r = a / B^count (limb shift)
+bool bigShiftRight(bigNumber *r, const bigNumber *a, size_t count)
+{
+	if (count >= a->length)
+	{
+		return bigAllocate(r, 0);
+	}
+
+	return bigCopy(r, a->limbs + count, a->length - count);
+}
+
+// Replaces x by the result of an operation which allocated a new number
+void bigReplace(bigNumber *x, bigNumber *value)
+{
+	bigFree(x);
+	*x = *value;
+}
+
+// q = a / divisor, returns the remainder. q may be a.
+uint32_t bigDivSmall(uint32_t *q, const uint32_t *a, size_t length, uint32_t divisor)
+{
+	uint64_t remainder = 0;
+
+	while (length-- > 0)
+	{
+		remainder = (remainder << 32) | a[length];
+		q[length] = (uint32_t)(remainder / divisor);
+		remainder %= divisor;
+	}
+
+	return (uint32_t)remainder;
+}
+
+// Schoolbook division (Knuth, TAOCP Vol. 2, Algorithm D): q = a / b, r = a % b for a >= b, b with at least two limbs
+bool bigDivKnuth(bigNumber *q, bigNumber *r, const bigNumber *a, const bigNumber *b)
+{
+	size_t m = a->length, n = b->length, i, j;
+	uint32_t *un = NULL, *vn = NULL;
+	uint64_t numerator = 0, qhat = 0, rhat = 0, product = 0;
+	int64_t t = 0, k = 0;
+	int shift = 0;
+
+	// Normalize, so the most significant bit of the divisor is set
+	while (((b->limbs[n - 1] << shift) & 0x80000000u) == 0)
+	{
+		shift++;
+	}
+
+	un = calloc(m + 1, sizeof(uint32_t));
+	vn = calloc(n, sizeof(uint32_t));
+
+	if (un == NULL || vn == NULL || !bigAllocate(q, m - n + 1))
+	{
+		free(un);
+		free(vn);
+		return false;
+	}
+
+	for (i = n - 1; i > 0; i--)
+	{
+		vn[i] = (b->limbs[i] << shift) | (shift ? b->limbs[i - 1] >> (32 - shift) : 0);
+	}
+
+	vn[0] = b->limbs[0] << shift;
+	un[m] = shift ? a->limbs[m - 1] >> (32 - shift) : 0;
+
+	for (i = m - 1; i > 0; i--)
+	{
+		un[i] = (a->limbs[i] << shift) | (shift ? a->limbs[i - 1] >> (32 - shift) : 0);
+	}
+
+	un[0] = a->limbs[0] << shift;
+
+	for (j = m - n + 1; j-- > 0; )
+	{
+		// Estimate the quotient limb from the top two limbs
+		numerator = ((uint64_t)un[j + n] << 32) | un[j + n - 1];
+		qhat = numerator / vn[n - 1];
+		rhat = numerator % vn[n - 1];
+
+		while ((qhat >> 32) != 0 || qhat * vn[n - 2] > ((rhat << 32) | un[j + n - 2]))
+		{
+			qhat--;
+			rhat += vn[n - 1];
+
+			if ((rhat >> 32) != 0)
+			{
+				break;
+			}
+		}
+
+		// Multiply and subtract
+		k = 0;
+
+		for (i = 0; i < n; i++)
+		{
+			product = qhat * vn[i];
+			t = (int64_t)un[i + j] - k - (int64_t)(product & 0xFFFFFFFFu);
+			un[i + j] = (uint32_t)t;
+			k = (int64_t)(product >> 32) - (t >> 32);
+		}
+
+		t = (int64_t)un[j + n] - k;
+		un[j + n] = (uint32_t)t;
+		q->limbs[j] = (uint32_t)qhat;
+
+		// Estimate was one too large, add back
+		if (t < 0)
+		{
+			q->limbs[j]--;
+			k = 0;
+
+			for (i = 0; i < n; i++)
+			{
+				t = (int64_t)un[i + j] + vn[i] + k;
+				un[i + j] = (uint32_t)t;
+				k = t >> 32;
+			}
+
+			un[j + n] += (uint32_t)k;
+		}
+	}
+
+	// Unnormalize the remainder
+	if (!bigAllocate(r, n))
+	{
+		bigFree(q);
+		free(un);
+		free(vn);
+		return false;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		r->limbs[i] = (un[i] >> shift) | (shift ? un[i + 1] << (32 - shift) : 0);
+	}
+
+	bigNormalize(q);
+	bigNormalize(r);
+	free(un);
+	free(vn);
+
+	return true;
+}
+
+// r = a * B^count (limb shift)
+bool bigShiftLeft(bigNumber *r, const bigNumber *a, size_t count)
+{
+	if (!bigAllocate(r, a->length + count))
+	{
+		return false;
+	}
+
+	if (a->length > 0)
+	{
+		memcpy(r->limbs + count, a->limbs, a->length * sizeof(uint32_t));
+	}
+
+	bigNormalize(r);
+
+	return true;
+}
+
+// Newton iteration x = x + x * (B^m - b * x) / B^m for the reciprocal R = floor(B^m / b).
+// Starting from an estimate x <= R the iteration approaches R from below and doubles the
+// number of correct digits per step. The last step is corrected with t = B^m - b * x, so x = R.
+bool bigNewtonReciprocal(const bigNumber *b, size_t m, bigNumber *x)
+{
+	bigNumber power = {NULL, 0}, t = {NULL, 0}, product = {NULL, 0}, temporary = {NULL, 0};
+	bigNumber increment = {NULL, 0}, one = {NULL, 0};
+	bool result = false;
+
+	if (!bigAllocate(&power, m + 1) || !bigAllocate(&one, 1))
+	{
+		goto cleanup;
+	}
+
+	power.limbs[m] = 1;
+	one.limbs[0] = 1;
+
+	// t = B^m - b * x, never negative for an estimate from below
+	if (!bigMul(&product, b, x) || bigCompare(&product, &power) > 0 || !bigSub(&t, &power, &product))
+	{
+		goto cleanup;
+	}
+
+	bigFree(&product);
+
+	while (true)
+	{
+		if (!bigMul(&temporary, x, &t) || !bigShiftRight(&increment, &temporary, m))
+		{
+			goto cleanup;
+		}
+
+		bigFree(&temporary);
+
+		if (increment.length == 0)
+		{
+			break;
+		}
+
+		if (!bigAdd(&temporary, x, &increment))
+		{
+			goto cleanup;
+		}
+
+		bigReplace(x, &temporary);
+		temporary.limbs = NULL;
+
+		// Error below one limb after this step? Then t is updated cheaply and the correction
+		// below removes the remaining few units, instead of another full step.
+		if (2 * increment.length + 2 <= x->length)
+		{
+			if (!bigMul(&product, b, &increment) || bigCompare(&product, &t) > 0 || !bigSub(&temporary, &t, &product))
+			{
+				goto cleanup;
+			}
+
+			bigReplace(&t, &temporary);
+			temporary.limbs = NULL;
+			break;
+		}
+
+		bigFree(&increment);
+		bigFree(&t);
+
+		if (!bigMul(&product, b, x) || bigCompare(&product, &power) > 0 || !bigSub(&t, &power, &product))
+		{
+			goto cleanup;
+		}
+
+		bigFree(&product);
+	}
+
+	// The iteration ends a few units below R at most
+	while (bigCompare(&t, b) >= 0)
+	{
+		if (!bigSub(&temporary, &t, b))
+		{
+			goto cleanup;
+		}
+
+		bigReplace(&t, &temporary);
+		temporary.limbs = NULL;
+
+		if (!bigAdd(&temporary, x, &one))
+		{
+			goto cleanup;
+		}
+
+		bigReplace(x, &temporary);
+		temporary.limbs = NULL;
+	}
+
+	result = true;
+
+cleanup:
+	bigFree(&power);
+	bigFree(&one);
+	bigFree(&t);
+	bigFree(&product);
+	bigFree(&temporary);
+	bigFree(&increment);
+
+	return result;
+}
+
+// Reciprocal x = floor(B^2n / b) of a divisor with n limbs. The estimate is derived from the
+// reciprocal of the upper half of b (recursively), so only the last Newton steps use the full precision.
+bool bigReciprocal(bigNumber *x, const bigNumber *b)
+{
+	bigNumber power = {NULL, 0}, remainder = {NULL, 0}, top = {NULL, 0}, topReciprocal = {NULL, 0}, one = {NULL, 0};
+	size_t n = b->length, half = (n + 1) / 2;
+	long exponent = 0;
+	bool result = false;
+
+	x->limbs = NULL;
+	x->length = 0;
+
+	if (n < BIG_NEWTON_THRESHOLD)
+	{
+		if (bigAllocate(&power, 2 * n + 1))
+		{
+			power.limbs[2 * n] = 1;
+			result = bigDivMod(x, &remainder, &power, b);
+		}
+
+		bigFree(&power);
+		bigFree(&remainder);
+
+		return result;
+	}
+
+	if (!bigAllocate(&one, 1))
+	{
+		return false;
+	}
+
+	one.limbs[0] = 1;
+
+	// b < (top + 1) * B^(n - half), so the scaled reciprocal of top + 1 is an estimate from below
+	if (bigShiftRight(&power, b, n - half) && bigAdd(&top, &power, &one) && bigReciprocal(&topReciprocal, &top))
+	{
+		exponent = (long)(n + half) - 2 * (long)top.length;
+
+		if (exponent >= 0)
+		{
+			result = bigShiftLeft(x, &topReciprocal, exponent);
+		}
+		else
+		{
+			result = bigShiftRight(x, &topReciprocal, -exponent);
+		}
+
+		result = result && bigNewtonReciprocal(b, 2 * n, x);
+	}
+
+	bigFree(&power);
+	bigFree(&top);
+	bigFree(&topReciprocal);
+	bigFree(&one);
+
+	if (!result)
+	{
+		bigFree(x);
+	}
+
+	return result;
+}
+
+// Division by Newton iteration: q = a / b, r = a % b for a >= b, b with at least BIG_NEWTON_THRESHOLD limbs.
+// With m = a.length and R = floor(B^m / b) the estimate q = a * R / B^m is at most one too small.
+// A known reciprocal floor(B^2n / b) can be passed in, otherwise (NULL) it is calculated.
+bool bigDivNewton(bigNumber *q, bigNumber *r, const bigNumber *a, const bigNumber *b, const bigNumber *knownReciprocal)
+{
+	bigNumber reciprocal = {NULL, 0}, x = {NULL, 0}, product = {NULL, 0}, temporary = {NULL, 0}, one = {NULL, 0};
+	size_t m = a->length, n = b->length;
+	bool result = false;
+
+	if (!bigAllocate(&one, 1) || (knownReciprocal == NULL && !bigReciprocal(&reciprocal, b)))
+	{
+		goto cleanup;
+	}
+
+	one.limbs[0] = 1;
+
+	if (knownReciprocal == NULL)
+	{
+		knownReciprocal = &reciprocal;
+	}
+
+	// Scale floor(B^2n / b) to B^m, shifting it down keeps it exact, shifting it up needs Newton steps
+	if (m <= 2 * n)
+	{
+		if (!bigShiftRight(&x, knownReciprocal, 2 * n - m))
+		{
+			goto cleanup;
+		}
+	}
+	else if (!bigShiftLeft(&x, knownReciprocal, m - 2 * n) || !bigNewtonReciprocal(b, m, &x))
+	{
+		goto cleanup;
+	}
+
+	// Quotient and remainder
+	if (!bigMul(&temporary, a, &x) || !bigShiftRight(q, &temporary, m))
+	{
+		goto cleanup;
+	}
+
+	bigFree(&temporary);
+
+	if (!bigMul(&product, q, b) || !bigSub(r, a, &product))
+	{
+		goto cleanup;
+	}
+
+	while (bigCompare(r, b) >= 0)
+	{
+		if (!bigSub(&temporary, r, b))
+		{
+			goto cleanup;
+		}
+
+		bigReplace(r, &temporary);
+		temporary.limbs = NULL;
+
+		if (!bigAdd(&temporary, q, &one))
+		{
+			goto cleanup;
+		}
+
+		bigReplace(q, &temporary);
+		temporary.limbs = NULL;
+	}
+
+	result = true;
+
+cleanup:
+	bigFree(&reciprocal);
+	bigFree(&one);
+	bigFree(&x);
+	bigFree(&product);
+	bigFree(&temporary);
+
+	return result;
+}
+
+// q = a / b, r = a % b, returns false for a division by zero
+bool bigDivMod(bigNumber *q, bigNumber *r, const bigNumber *a, const bigNumber *b)
+{
+	if (b->length == 0)
+	{
+		return false;
+	}
+
+	if (bigCompare(a, b) < 0)
+	{
+		return bigAllocate(q, 0) && bigCopy(r, a->limbs, a->length);
+	}
+
+	if (b->length == 1)
+	{
+		if (!bigAllocate(q, a->length) || !bigAllocate(r, 1))
+		{
+			return false;
+		}
+
+		r->limbs[0] = bigDivSmall(q->limbs, a->limbs, a->length, b->limbs[0]);
+		bigNormalize(q);
+		bigNormalize(r);
+
+		return true;
+	}
+
+	// Newton iteration pays off for large divisors and quotients
+	if (b->length >= BIG_NEWTON_THRESHOLD && a->length - b->length >= BIG_NEWTON_THRESHOLD)
+	{
+		return bigDivNewton(q, r, a, b, NULL);
+	}
+
+	return bigDivKnuth(q, r, a, b);
+}
+
+// Returns 10^(9 * 2^index) from the cache, the powers are calculated by repeated squaring
+const bigNumber *bigPowerOfTen(size_t index)
+{
+	static bigNumber powers[MAX_BIG_POWERS];
+	static size_t count = 0;
+
+	if (index >= MAX_BIG_POWERS)
+	{
+		return NULL;
+	}
+
+	if (count == 0)
+	{
+		if (!bigAllocate(&powers[0], 1))
+		{
+			return NULL;
+		}
+
+		powers[0].limbs[0] = 1000000000u;
+		count = 1;
+	}
+
+	while (count <= index)
+	{
+		if (!bigMul(&powers[count], &powers[count - 1], &powers[count - 1]))
+		{
+			return NULL;
+		}
+
+		count++;
+	}
+
+	return &powers[index];
+}
+
+// Returns the reciprocal floor(B^2n / 10^(9 * 2^index)) of a cached power of ten with n limbs,
+// so the conversion to decimal digits divides by the same power without recalculating it
+const bigNumber *bigPowerOfTenReciprocal(size_t index)
+{
+	static bigNumber reciprocals[MAX_BIG_POWERS];
+	const bigNumber *power = bigPowerOfTen(index);
+
+	if (power == NULL)
+	{
+		return NULL;
+	}
+
+	if (reciprocals[index].limbs == NULL && !bigReciprocal(&reciprocals[index], power))
+	{
+		return NULL;
+	}
+
+	return &reciprocals[index];
+}
+
+// Fills the caches before the server takes traffic, the forked client processes inherit them:
+// the powers of ten (and reciprocals) for decimal conversions of up to about 36000 digits,
+// the lazily bound math library functions and the static files with their encoded variants
+void warmUpServer(void)
+{
+	const bigNumber *power = NULL;
+	double a[2] = {0.5, 2.0}, b[2] = {2.0, 0.5}, results[2];
+	int operation;
+	size_t index;
+
+	for (index = 0; index < WARM_BIG_POWERS; index++)
+	{
+		if ((power = bigPowerOfTen(index)) != NULL && power->length >= BIG_NEWTON_THRESHOLD)
+		{
+			bigPowerOfTenReciprocal(index);
+		}
+	}
+
+	for (operation = OPERATION_ADD; operation <= OPERATION_TAN; operation++)
+	{
+		calculate(operation, a, b, results, 2);
+	}
+
+	loadStaticAssets();
+}
+
+// r = 10^exponent
+bool bigPowerOfTenExponent(bigNumber *r, size_t exponent)
+{
+	const uint32_t smallPowers[9] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+	const bigNumber *power = NULL;
+	bigNumber temporary = {NULL, 0};
+	size_t groups = exponent / 9, index = 0;
+
+	if (!bigAllocate(r, 1))
+	{
+		return false;
+	}
+
+	r->limbs[0] = smallPowers[exponent % 9];
+
+	// Multiply with 10^(9 * 2^index) for every bit of exponent / 9
+	for (index = 0; groups > 0; index++, groups >>= 1)
+	{
+		if ((groups & 1) == 0)
+		{
+			continue;
+		}
+
+		if ((power = bigPowerOfTen(index)) == NULL || !bigMul(&temporary, r, power))
+		{
+			bigFree(r);
+			return false;
+		}
+
+		bigReplace(r, &temporary);
+	}
+
+	return true;
+}
+
+// Converts a string of decimal digits. Long strings are split in a high and a low part
+// (divide and conquer), so the conversion costs a few multiplications instead of O(n^2).
+bool bigFromDigits(bigNumber *r, const char *digits, size_t length)
+{
+	bigNumber high = {NULL, 0}, low = {NULL, 0}, temporary = {NULL, 0};
+	const bigNumber *power = NULL;
+	size_t index = 0, lowLength = 9, i = 0, used = 0, count = 0;
+	uint64_t carry = 0;
+	uint32_t group = 0;
+	bool result = false;
+
+	if (length <= 9 * BIG_CONVERSION_THRESHOLD)
+	{
+		if (!bigAllocate(r, length / 9 + 1))
+		{
+			return false;
+		}
+
+		// r = r * 10^9 + group for every group of nine digits, the first group may be shorter
+		while (length > 0)
+		{
+			count = (length % 9 == 0) ? 9 : length % 9;
+			group = 0;
+
+			for (i = 0; i < count; i++)
+			{
+				group = group * 10 + (uint32_t)(*digits++ - '0');
+			}
+
+			length -= count;
+			carry = group;
+
+			for (i = 0; i < used; i++)
+			{
+				carry += (uint64_t)r->limbs[i] * 1000000000u;
+				r->limbs[i] = (uint32_t)carry;
+				carry >>= 32;
+			}
+
+			if (carry > 0)
+			{
+				r->limbs[used++] = (uint32_t)carry;
+			}
+		}
+
+		r->length = used;
+		bigNormalize(r);
+
+		return true;
+	}
+
+	// Largest power with lowLength = 9 * 2^index < length
+	while (lowLength * 2 < length)
+	{
+		lowLength *= 2;
+		index++;
+	}
+
+	if ((power = bigPowerOfTen(index)) != NULL &&
+		bigFromDigits(&high, digits, length - lowLength) &&
+		bigFromDigits(&low, digits + length - lowLength, lowLength) &&
+		bigMul(&temporary, &high, power) &&
+		bigAdd(r, &temporary, &low))
+	{
+		result = true;
+	}
+
+	bigFree(&high);
+	bigFree(&low);
+	bigFree(&temporary);
+
+	return result;
+}
+
+// Writes the decimal digits of x to text. With width > 0 exactly width digits are written (zero padded),
+// otherwise the digits without leading zeros (none for zero). Large numbers are split by a division
+// through 10^(9 * 2^index) (divide and conquer). Returns the number of digits or -1 on errors.
+long bigToDigits(const bigNumber *x, char *text, size_t width)
+{
+	bigNumber copy = {NULL, 0}, q = {NULL, 0}, r = {NULL, 0};
+	const bigNumber *power = NULL, *reciprocal = NULL;
+	uint32_t *groups = NULL;
+	size_t groupCount = 0, index = 0, lowLength = 9, i = 0;
+	long length = 0, highLength = 0;
+	int groupLength = 0;
+	char groupText[16] = {0, };
+
+	if (x->length <= BIG_CONVERSION_THRESHOLD)
+	{
+		if (!bigCopy(&copy, x->limbs, x->length) || (groups = malloc((2 * x->length + 1) * sizeof(uint32_t))) == NULL)
+		{
+			bigFree(&copy);
+			return -1;
+		}
+
+		// Split into groups of nine digits, least significant first
+		while (copy.length > 0)
+		{
+			groups[groupCount++] = bigDivSmall(copy.limbs, copy.limbs, copy.length, 1000000000u);
+			bigNormalize(&copy);
+		}
+
+		if (groupCount > 0)
+		{
+			groupLength = snprintf(groupText, sizeof(groupText), "%u", (unsigned int)groups[groupCount - 1]);
+			length = groupLength + 9 * (long)(groupCount - 1);
+		}
+
+		// Leading zeros
+		if (width > (size_t)length)
+		{
+			memset(text, '0', width - length);
+			text += width - length;
+			length = width;
+		}
+
+		if (groupCount > 0)
+		{
+			memcpy(text, groupText, groupLength);
+			text += groupLength;
+
+			for (i = groupCount - 1; i-- > 0; )
+			{
+				snprintf(groupText, sizeof(groupText), "%09u", (unsigned int)groups[i]);
+				memcpy(text, groupText, 9);
+				text += 9;
+			}
+		}
+
+		bigFree(&copy);
+		free(groups);
+
+		return length;
+	}
+
+	// Largest power of ten with about half the limbs of x
+	while ((power = bigPowerOfTen(index + 1)) != NULL && power->length * 2 <= x->length + 1)
+	{
+		index++;
+		lowLength *= 2;
+	}
+
+	if ((power = bigPowerOfTen(index)) == NULL)
+	{
+		return -1;
+	}
+
+	// Large powers use the cached reciprocal
+	if (power->length >= BIG_NEWTON_THRESHOLD && x->length - power->length >= BIG_NEWTON_THRESHOLD)
+	{
+		if ((reciprocal = bigPowerOfTenReciprocal(index)) == NULL || !bigDivNewton(&q, &r, x, power, reciprocal))
+		{
+			return -1;
+		}
+	}
+	else if (!bigDivMod(&q, &r, x, power))
+	{
+		return -1;
+	}
+
+	// High part and zero padded low part
+	highLength = bigToDigits(&q, text, (width > lowLength) ? width - lowLength : 0);
+
+	if (highLength < 0 || bigToDigits(&r, text + highLength, lowLength) < 0)
+	{
+		length = -1;
+	}
+	else
+	{
+		length = highLength + lowLength;
+	}
+
+	bigFree(&q);
+	bigFree(&r);
+
+	return length;
+}
+
+// Parses a decimal number of the form [+|-]digits[.digits]
+bool parseBigDecimal(const char *text, bigDecimal *result)
+{
+	char *digits = NULL;
+	size_t count = 0;
+	bool point = false, valid = true;
+
+	result->magnitude.limbs = NULL;
+	result->magnitude.length = 0;
+	result->negative = false;
+	result->scale = 0;
+
+	if (*text == '-' || *text == '+')
+	{
+		result->negative = (*text == '-');
+		text++;
+	}
+
+	if ((digits = malloc(strlen(text) + 1)) == NULL)
+	{
+		return false;
+	}
+
+	for (; *text != '\0' && valid; text++)
+	{
+		if (*text >= '0' && *text <= '9')
+		{
+			digits[count++] = *text;
+
+			if (point)
+			{
+				result->scale++;
+			}
+		}
+		else if (*text == '.' && !point)
+		{
+			point = true;
+		}
+		else
+		{
+			valid = false;
+		}
+	}
+
+	valid = valid && count > 0 && bigFromDigits(&result->magnitude, digits, count);
+	free(digits);
+
+	return valid;
+}
+
+// Multiplies the magnitude with 10^(scale - x.scale), so x gets the given (larger) scale
+bool rescaleBigDecimal(bigDecimal *x, size_t scale)
+{
+	bigNumber power = {NULL, 0}, temporary = {NULL, 0};
+	bool result = false;
+
+	if (scale <= x->scale)
+	{
+		return true;
+	}
+
+	if (bigPowerOfTenExponent(&power, scale - x->scale) && bigMul(&temporary, &x->magnitude, &power))
+	{
+		bigReplace(&x->magnitude, &temporary);
+		x->scale = scale;
+		result = true;
+	}
+
+	bigFree(&power);
+
+	return result;
+}
+
+// Calculates the exact result of add, sub, mul, div or mod of two decimal numbers. Division results are
+// truncated after max(BIG_DIVISION_SCALE, scale of the operands) fractional digits, mod has the sign of a.
+// Returns the HTTP status code: 200 on success, 500 on a division by zero or if out of memory.
+int calculateBigDecimal(const char *operation, bigDecimal *a, bigDecimal *b, bigDecimal *result)
+{
+	bigNumber power = {NULL, 0}, numerator = {NULL, 0}, denominator = {NULL, 0}, remainder = {NULL, 0};
+	size_t scale = (a->scale > b->scale) ? a->scale : b->scale;
+	bool negativeB = b->negative;
+	bool success = false;
+
+	result->magnitude.limbs = NULL;
+	result->magnitude.length = 0;
+	result->negative = false;
+	result->scale = 0;
+
+	if (strcmp(operation, "mul") == 0)
+	{
+		result->negative = a->negative != b->negative;
+		result->scale = a->scale + b->scale;
+
+		return bigMul(&result->magnitude, &a->magnitude, &b->magnitude) ? 200 : 500;
+	}
+
+	if (strcmp(operation, "div") == 0)
+	{
+		if (b->magnitude.length == 0)
+		{
+			return 500;
+		}
+
+		// a / b = (A * 10^(b.scale + scale)) / (B * 10^a.scale) / 10^scale
+		scale = (scale > BIG_DIVISION_SCALE) ? scale : BIG_DIVISION_SCALE;
+		result->negative = a->negative != b->negative;
+		result->scale = scale;
+
+		success = bigPowerOfTenExponent(&power, b->scale + scale) && bigMul(&numerator, &a->magnitude, &power);
+		bigFree(&power);
+
+		success = success && bigPowerOfTenExponent(&power, a->scale) && bigMul(&denominator, &b->magnitude, &power) &&
+				  bigDivMod(&result->magnitude, &remainder, &numerator, &denominator);
+
+		bigFree(&power);
+		bigFree(&numerator);
+		bigFree(&denominator);
+		bigFree(&remainder);
+
+		return success ? 200 : 500;
+	}
+
+	// add, sub and mod work on operands with the same scale
+	if (!rescaleBigDecimal(a, scale) || !rescaleBigDecimal(b, scale))
+	{
+		return 500;
+	}
+
+	result->scale = scale;
+
+	if (strcmp(operation, "mod") == 0)
+	{
+		if (b->magnitude.length == 0)
+		{
+			return 500;
+		}
+
+		result->negative = a->negative;
+		success = bigDivMod(&numerator, &result->magnitude, &a->magnitude, &b->magnitude);
+		bigFree(&numerator);
+
+		return success ? 200 : 500;
+	}
+
+	if (strcmp(operation, "sub") == 0)
+	{
+		negativeB = !negativeB;
+	}
+
+	if (a->negative == negativeB)
+	{
+		result->negative = a->negative;
+		success = bigAdd(&result->magnitude, &a->magnitude, &b->magnitude);
+	}
+	else if (bigCompare(&a->magnitude, &b->magnitude) >= 0)
+	{
+		result->negative = a->negative;
+		success = bigSub(&result->magnitude, &a->magnitude, &b->magnitude);
+	}
+	else
+	{
+		result->negative = negativeB;
+		success = bigSub(&result->magnitude, &b->magnitude, &a->magnitude);
+	}
+
+	return success ? 200 : 500;
+}
+
+// Formats a decimal number, trailing zeros after the decimal point are removed
+char *formatBigDecimal(const bigDecimal *x)
+{
+	char *digits = NULL, *text = NULL, *position = NULL;
+	long count = 0, integerDigits = 0, fractionEnd = 0, n = 0;
+	long scale = (long)x->scale;
+
+	if ((digits = malloc(x->magnitude.length * 10 + 16)) == NULL || (count = bigToDigits(&x->magnitude, digits, 0)) < 0 ||
+		(text = malloc(count + scale + 4)) == NULL)
+	{
+		free(digits);
+		return NULL;
+	}
+
+	position = text;
+
+	if (count == 0)
+	{
+		strcpy(text, "0");
+		free(digits);
+		return text;
+	}
+
+	if (x->negative)
+	{
+		*position++ = '-';
+	}
+
+	// Integer part
+	integerDigits = (count > scale) ? count - scale : 0;
+
+	if (integerDigits == 0)
+	{
+		*position++ = '0';
+	}
+	else
+	{
+		memcpy(position, digits, integerDigits);
+		position += integerDigits;
+	}
+
+	// Fraction part without trailing zeros
+	fractionEnd = count;
+
+	while (fractionEnd > integerDigits && digits[fractionEnd - 1] == '0')
+	{
+		fractionEnd--;
+	}
+
+	if (fractionEnd > integerDigits)
+	{
+		*position++ = '.';
+
+		for (n = count; n < scale; n++)
+		{
+			*position++ = '0';
+		}
+
+		memcpy(position, &digits[integerDigits], fractionEnd - integerDigits);
+		position += fractionEnd - integerDigits;
+	}
+
+	*position = '\0';
+	free(digits);
+
+	return text;
+}
+
+// Calculates the operation of two arbitrary-precision decimal numbers and streams the result to the client
+void processBigRequest(int clientIndex, const char *operation, const char *text1, const char *text2, bool sendPayload, bool chunked)
+{
+	const char bigTemplateStart[] = "<html><head><title>Calculator</title></head><body>The result of your requested operation (%s) is ";
+	const char bigTemplateEnd[] = ".</body></html>";
+	bigDecimal a, b, result;
+	responseStream stream;
+	char *resultText = NULL;
+	int statusCode = 200;
+	bool valid1 = false, valid2 = false;
+
+	result.magnitude.limbs = NULL;
+
+	// Convert operands
+	valid1 = parseBigDecimal(text1, &a);
+	valid2 = parseBigDecimal(text2, &b);
+
+	if (!valid1 || !valid2)
+	{
+		statusCode = 500;
+	}
+	else
+	{
+		// Calculate result
+		statusCode = calculateBigDecimal(operation, &a, &b, &result);
+
+		if (statusCode == 200 && (resultText = formatBigDecimal(&result)) == NULL)
+		{
+			statusCode = 500;
+		}
+	}
+
+	bigFree(&a.magnitude);
+	bigFree(&b.magnitude);
+	bigFree(&result.magnitude);
+
+	if (statusCode != 200)
+	{
+		// Build HTTP response
+		buildResponseHeader(statusCode, "text/html");
+
+		// Send data
+		sendDataToClient(clientIndex, sendPayload, NULL);
+
+		return;
+	}
+
+	// Build HTTP response
+	buildResponseHeader(200, "text/html");
+
+	// Stream the webpage, the result might be larger than the payload buffer
+	if (startResponseStream(&stream, clientIndex, chunked) &&
+		(!sendPayload || (printResponseStream(&stream, bigTemplateStart, operation) &&
+						  writeResponseStream(&stream, resultText, strlen(resultText)) &&
+						  printResponseStream(&stream, bigTemplateEnd) &&
+						  finishResponseStream(&stream))))
+	{
+		printf("INFO: Data sent to client OK!\n");
+	}
+	else
+	{
+		printf("ERROR: Error sending Payload to client!\n");
+	}
+
+	free(resultText);
+
+	// Close connection
+	closeConnection(clientIndex);
+}
+
+// Sets the capacities of the sketch levels, which shrink by 2/3 per level below the top
+void updateSketchCapacities(quantileSketch *sketch)
+{
+	double capacity = SKETCH_SIZE;
+	int level;
+
+	for (level = sketch->levels - 1; level >= 0; level--)
+	{
+		sketch->capacities[level] = (capacity < SKETCH_MIN_CAPACITY) ? SKETCH_MIN_CAPACITY : (int)capacity;
+		capacity *= 2.0 / 3.0;
+	}
+}
+
+void initializeSketch(quantileSketch *sketch, uint64_t seed)
+{
+	memset(sketch->sizes, 0, sizeof(sketch->sizes));
+	sketch->levels = 1;
+	sketch->random = seed | 1;
+	updateSketchCapacities(sketch);
+}
+
+// Sorts in place without the comparison callback of qsort (quicksort, insertion sort for short ranges)
+void sortDoubles(double *values, int count)
+{
+	double pivot, swap;
+	int i, j;
+
+	while (count > 16)
+	{
+		pivot = values[count / 2];
+		i = 0;
+		j = count - 1;
+
+		while (i <= j)
+		{
+			while (values[i] < pivot)
+			{
+				i++;
+			}
+
+			while (values[j] > pivot)
+			{
+				j--;
+			}
+
+			if (i <= j)
+			{
+				swap = values[i];
+				values[i++] = values[j];
+				values[j--] = swap;
+			}
+		}
+
+		// Recurse into the smaller part, so the depth stays logarithmic
+		if (j + 1 < count - i)
+		{
+			sortDoubles(values, j + 1);
+			values += i;
+			count -= i;
+		}
+		else
+		{
+			sortDoubles(values + i, count - i);
+			count = j + 1;
+		}
+	}
+
+	for (i = 1; i < count; i++)
+	{
+		swap = values[i];
+
+		for (j = i; j > 0 && values[j - 1] > swap; j--)
+		{
+			values[j] = values[j - 1];
+		}
+
+		values[j] = swap;
+	}
+}
+
+int compareDoubles(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+// Sorts a full level and promotes either the even or the odd items to the next level,
+// an odd item count leaves one item behind
+void compactSketch(quantileSketch *sketch, int level)
+{
+	double *items = sketch->items[level];
+	int size = sketch->sizes[level];
+	int pairs = size & ~1;
+	int n = 0;
+
+	sortDoubles(items, pairs);
+
+	// Random offset (xorshift), so the rank error is unbiased
+	sketch->random ^= sketch->random << 13;
+	sketch->random ^= sketch->random >> 7;
+	sketch->random ^= sketch->random << 17;
+
+	if (level + 1 == sketch->levels && sketch->levels < MAX_SKETCH_LEVELS)
+	{
+		sketch->levels++;
+		updateSketchCapacities(sketch);
+	}
+
+	// The top level can only be reached with more than 2^MAX_SKETCH_LEVELS values,
+	// it would just drop the promoted items
+	if (level + 1 < sketch->levels)
+	{
+		for (n = (int)(sketch->random & 1); n < pairs; n += 2)
+		{
+			insertSketch(sketch, level + 1, items[n]);
+		}
+	}
+
+	if (size > pairs)
+	{
+		items[0] = items[pairs];
+	}
+
+	sketch->sizes[level] = size - pairs;
+}
+
+void insertSketch(quantileSketch *sketch, int level, double value)
+{
+	sketch->items[level][sketch->sizes[level]++] = value;
+
+	if (sketch->sizes[level] >= sketch->capacities[level])
+	{
+		compactSketch(sketch, level);
+	}
+}
+
+void mergeSketch(quantileSketch *sketch, const quantileSketch *other)
+{
+	int level, n;
+
+	if (other->levels > sketch->levels)
+	{
+		sketch->levels = other->levels;
+		updateSketchCapacities(sketch);
+	}
+
+	for (level = 0; level < other->levels; level++)
+	{
+		for (n = 0; n < other->sizes[level]; n++)
+		{
+			insertSketch(sketch, level, other->items[level][n]);
+		}
+	}
+}
+
+// Weighted sketch item, used to answer quantile queries
+typedef struct
+{
+	double value;
+	double weight;
+} sketchItem;
+
+int compareSketchItems(const void *a, const void *b)
+{
+	return compareDoubles(&((const sketchItem *)a)->value, &((const sketchItem *)b)->value);
+}
+
+// Estimates the quantiles q[0..count-1] (0 <= q <= 1) as the smallest items whose
+// cumulative weight reaches q times the total weight. Returns false if out of memory.
+bool querySketch(const quantileSketch *sketch, const double *q, int count, double *result)
+{
+	sketchItem *items = NULL;
+	double total = 0, cumulative = 0;
+	int itemCount = 0, level, n, k;
+
+	for (level = 0; level < sketch->levels; level++)
+	{
+		itemCount += sketch->sizes[level];
+	}
+
+	if (itemCount == 0)
+	{
+		for (k = 0; k < count; k++)
+		{
+			result[k] = NAN;
+		}
+
+		return true;
+	}
+
+	if ((items = malloc(itemCount * sizeof(sketchItem))) == NULL)
+	{
+		return false;
+	}
+
+	for (level = 0, itemCount = 0; level < sketch->levels; level++)
+	{
+		for (n = 0; n < sketch->sizes[level]; n++, itemCount++)
+		{
+			items[itemCount].value = sketch->items[level][n];
+			items[itemCount].weight = ldexp(1.0, level);
+			total += items[itemCount].weight;
+		}
+	}
+
+	qsort(items, itemCount, sizeof(sketchItem), compareSketchItems);
+
+	for (k = 0; k < count; k++)
+	{
+		cumulative = 0;
+
+		for (n = 0; n < itemCount - 1; n++)
+		{
+			cumulative += items[n].weight;
+
+			if (cumulative >= q[k] * total)
+			{
+				break;
+			}
+		}
+
+		result[k] = items[n].value;
+	}
+
+	free(items);
+
+	return true;
+}
+
+void initializeStatistics(statisticsState *state, uint64_t seed)
+{
+	state->count = 0;
+	state->sum = 0;
+	state->mean = 0;
+	state->m2 = 0;
+	state->minimum = INFINITY;
+	state->maximum = -INFINITY;
+	initializeSketch(&state->sketch, seed);
+}
+
+// Combines count, mean and sum of squared deviations of two parts (Chan et al.)
+void mergeMoments(statisticsState *state, long long count, double sum, double mean, double m2)
+{
+	long long total = state->count + count;
+	double delta = mean - state->mean;
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	state->mean += delta * count / total;
+	state->m2 += m2 + delta * delta * ((double)state->count * count / total);
+	state->sum += sum;
+	state->count = total;
+}
+
+void mergeStatistics(statisticsState *state, const statisticsState *other)
+{
+	mergeMoments(state, other->count, other->sum, other->mean, other->m2);
+	state->minimum = fmin(state->minimum, other->minimum);
+	state->maximum = fmax(state->maximum, other->maximum);
+	mergeSketch(&state->sketch, &other->sketch);
+}
+
+// Adds a batch of values. Sum, minimum and maximum and then the squared deviations from
+// the batch mean are reduced with independent lanes, so both passes vectorize.
+void addStatisticsBatch(statisticsState *state, const double *values, int count)
+{
+	double sums[8] = {0, }, squares[8] = {0, };
+	double minimums[8], maximums[8];
+	double sum = 0, m2 = 0, mean = 0;
+	int n = 0, lane;
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	for (lane = 0; lane < 8; lane++)
+	{
+		minimums[lane] = INFINITY;
+		maximums[lane] = -INFINITY;
+	}
+
+	for (n = 0; n + 8 <= count; n += 8)
+	{
+		for (lane = 0; lane < 8; lane++)
+		{
+			sums[lane] += values[n + lane];
+			minimums[lane] = (values[n + lane] < minimums[lane]) ? values[n + lane] : minimums[lane];
+			maximums[lane] = (values[n + lane] > maximums[lane]) ? values[n + lane] : maximums[lane];
+		}
+	}
+
+	for (; n < count; n++)
+	{
+		sum += values[n];
+		minimums[0] = (values[n] < minimums[0]) ? values[n] : minimums[0];
+		maximums[0] = (values[n] > maximums[0]) ? values[n] : maximums[0];
+	}
+
+	for (lane = 0; lane < 8; lane++)
+	{
+		sum += sums[lane];
+		state->minimum = fmin(state->minimum, minimums[lane]);
+		state->maximum = fmax(state->maximum, maximums[lane]);
+	}
+
+	mean = sum / count;
+
+	for (n = 0; n + 8 <= count; n += 8)
+	{
+		for (lane = 0; lane < 8; lane++)
+		{
+			squares[lane] += (values[n + lane] - mean) * (values[n + lane] - mean);
+		}
+	}
+
+	for (; n < count; n++)
+	{
+		m2 += (values[n] - mean) * (values[n] - mean);
+	}
+
+	for (lane = 0; lane < 8; lane++)
+	{
+		m2 += squares[lane];
+	}
+
+	mergeMoments(state, count, sum, mean, m2);
+
+	for (n = 0; n < count; n++)
+	{
+		insertSketch(&state->sketch, 0, values[n]);
+	}
+}
+
+// Parses a decimal number. Numbers with at most 15 digits and a small exponent are exact
+// products or quotients of two doubles (Clinger's fast path), all others go to strtod.
+double parseStatisticsNumber(const char *text, char **end)
+{
+	const double powersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+								  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+	const char *cursor = text;
+	bool negative = false;
+	int64_t mantissa = 0;
+	int digits = 0, exponent = 0, exponentValue = 0;
+	bool exponentNegative = false;
+	double value = 0;
+
+	if (*cursor == '-' || *cursor == '+')
+	{
+		negative = (*cursor++ == '-');
+	}
+
+	// Digits beyond the fast path limit are only counted, the mantissa must not overflow
+	for (; *cursor >= '0' && *cursor <= '9'; cursor++, digits++)
+	{
+		mantissa = (digits < 16) ? mantissa * 10 + (*cursor - '0') : mantissa;
+	}
+
+	if (*cursor == '.')
+	{
+		for (cursor++; *cursor >= '0' && *cursor <= '9'; cursor++, digits++, exponent--)
+		{
+			mantissa = (digits < 16) ? mantissa * 10 + (*cursor - '0') : mantissa;
+		}
+	}
+
+	if (*cursor == 'e' || *cursor == 'E')
+	{
+		cursor++;
+
+		if (*cursor == '-' || *cursor == '+')
+		{
+			exponentNegative = (*cursor++ == '-');
+		}
+
+		if (*cursor < '0' || *cursor > '9')
+		{
+			digits = 0;
+		}
+
+		for (; *cursor >= '0' && *cursor <= '9' && exponentValue < 1000; cursor++)
+		{
+			exponentValue = exponentValue * 10 + (*cursor - '0');
+		}
+
+		exponent += exponentNegative ? -exponentValue : exponentValue;
+	}
+
+	if (digits == 0 || digits > 15 || exponent < -22 || exponent > 22 || (*cursor >= '0' && *cursor <= '9'))
+	{
+		return strtod(text, end);
+	}
+
+	value = (exponent < 0) ? (double)mantissa / powersOfTen[-exponent] : (double)mantissa * powersOfTen[exponent];
+	*end = (char *)cursor;
+
+	return negative ? -value : value;
+}
+
+// Parses one block of the input and adds its values to the state. Text blocks are zero
+// terminated and hold numbers separated by whitespace, commas or semicolons, binary blocks
+// hold little endian doubles. Returns false for invalid or non-finite values.
+bool addStatisticsBlock(statisticsState *state, char *block, size_t length, bool binary)
+{
+	const char separators[] = " \t\r\n,;";
+	double values[STATS_BATCH_SIZE];
+	char *cursor = block, *end = NULL;
+	int count = 0;
+	size_t n = 0;
+
+	if (binary)
+	{
+		for (n = 0; n + 8 <= length; n += 8)
+		{
+			values[count] = loadLittleEndianDouble((unsigned char *)block + n);
+
+			if (!isfinite(values[count]))
+			{
+				return false;
+			}
+
+			if (++count == STATS_BATCH_SIZE)
+			{
+				addStatisticsBatch(state, values, count);
+				count = 0;
+			}
+		}
+
+		addStatisticsBatch(state, values, count);
+
+		return n == length;
+	}
+
+	while (true)
+	{
+		// Skip separators
+		cursor += strspn(cursor, separators);
+
+		if (*cursor == '\0')
+		{
+			break;
+		}
+
+		values[count] = parseStatisticsNumber(cursor, &end);
+
+		if (end == cursor || !isfinite(values[count]) || (*end != '\0' && strchr(separators, *end) == NULL))
+		{
+			return false;
+		}
+
+		cursor = end;
+
+		if (++count == STATS_BATCH_SIZE)
+		{
+			addStatisticsBatch(state, values, count);
+			count = 0;
+		}
+	}
+
+	addStatisticsBatch(state, values, count);
+
+	return true;
+}
+
+// Takes filled blocks from the queue until the body is finished
+void *statisticsWorker(void *argument)
+{
+	statisticsTask *task = argument;
+	statisticsQueue *queue = task->queue;
+	bool valid = true;
+	int block;
+
+	while (true)
+	{
+		pthread_mutex_lock(&queue->lock);
+
+		if (!valid)
+		{
+			queue->invalid = true;
+		}
+
+		while (queue->filledCount == 0 && !queue->finished)
+		{
+			pthread_cond_wait(&queue->filled, &queue->lock);
+		}
+
+		if (queue->filledCount == 0)
+		{
+			pthread_mutex_unlock(&queue->lock);
+			break;
+		}
+
+		block = queue->filledBlocks[queue->filledStart];
+		queue->filledStart = (queue->filledStart + 1) % queue->blockCount;
+		queue->filledCount--;
+
+		pthread_mutex_unlock(&queue->lock);
+
+		// Invalid input makes the remaining blocks irrelevant
+		valid = valid && addStatisticsBlock(&task->state, queue->blocks[block], queue->lengths[block], queue->binary);
+
+		pthread_mutex_lock(&queue->lock);
+		queue->freeBlocks[queue->freeCount++] = block;
+		pthread_cond_signal(&queue->emptied);
+		pthread_mutex_unlock(&queue->lock);
+	}
+
+	return NULL;
+}
+
+// Reads the request body block by block and hands the blocks to the workers, or processes them
+// on the calling thread if there are none. Values split at a block end are carried to the next block.
+// Returns the HTTP status code: 200 on success, 400 for invalid input, 0 if the client disconnected.
+int readStatistics(requestBody *body, statisticsQueue *queue, int workerCount, statisticsState *state)
+{
+	const char separators[] = " \t\r\n,;";
+	char carry[MAX_STATS_TOKEN_LENGTH];
+	size_t carryLength = 0, length = 0, cut = 0;
+	ssize_t bytesRead = 0;
+	bool endOfBody = false;
+	int block = 0, statusCode = 200;
+
+	while (!endOfBody && statusCode == 200)
+	{
+		// Wait for a free block
+		pthread_mutex_lock(&queue->lock);
+
+		while (queue->freeCount == 0 && !queue->invalid)
+		{
+			pthread_cond_wait(&queue->emptied, &queue->lock);
+		}
+
+		if (queue->invalid)
+		{
+			statusCode = 400;
+		}
+		else
+		{
+			block = queue->freeBlocks[--queue->freeCount];
+		}
+
+		pthread_mutex_unlock(&queue->lock);
+
+		if (statusCode != 200)
+		{
+			break;
+		}
+
+		// Fill the block behind the carried bytes
+		memcpy(queue->blocks[block], carry, carryLength);
+		length = carryLength;
+
+		do
+		{
+			bytesRead = readRequestBody(body, queue->blocks[block] + length, STATS_BLOCK_SIZE - length);
+
+			if (bytesRead > 0)
+			{
+				length += bytesRead;
+			}
+		}
+		while (bytesRead > 0 && length < STATS_BLOCK_SIZE);
+
+		if (bytesRead < 0)
+		{
+			statusCode = 0;
+			endOfBody = true;
+		}
+		else if (bytesRead == 0)
+		{
+			endOfBody = true;
+		}
+
+		// Cut the block behind the last complete value
+		cut = length;
+
+		if (!endOfBody)
+		{
+			if (queue->binary)
+			{
+				cut -= length % 8;
+			}
+			else
+			{
+				while (cut > 0 && strchr(separators, queue->blocks[block][cut - 1]) == NULL)
+				{
+					cut--;
+				}
+			}
+		}
+
+		carryLength = length - cut;
+
+		if (carryLength > MAX_STATS_TOKEN_LENGTH)
+		{
+			statusCode = 400;
+		}
+		else
+		{
+			memcpy(carry, queue->blocks[block] + cut, carryLength);
+		}
+
+		queue->blocks[block][cut] = '\0';
+
+		pthread_mutex_lock(&queue->lock);
+
+		if (workerCount == 0)
+		{
+			// Process the block on the calling thread
+			if (!addStatisticsBlock(state, queue->blocks[block], cut, queue->binary))
+			{
+				queue->invalid = true;
+			}
+
+			queue->freeBlocks[queue->freeCount++] = block;
+		}
+		else
+		{
+			queue->lengths[block] = cut;
+			queue->filledBlocks[(queue->filledStart + queue->filledCount) % queue->blockCount] = block;
+			queue->filledCount++;
+			pthread_cond_signal(&queue->filled);
+		}
+
+		pthread_mutex_unlock(&queue->lock);
+	}
+
+	return statusCode;
+}
+
+// Computes the descriptive statistics of the numbers in the request body in a single pass,
+// the input is never stored as a whole. Large or chunked bodies are parsed by one worker per core.
+// Returns the HTTP status code: 200 on success, 400 for invalid input, 500 if out of memory
+// and 0 if the client disconnected.
+int calculateStatistics(requestBody *body, bool binary, statisticsState *state)
+{
+	statisticsQueue queue;
+	statisticsTask *tasks = NULL;
+	pthread_t threads[MAX_STATS_THREADS];
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	int count = 0, started = 0, n = 0, statusCode = 200;
+
+	// Use threads for large bodies only
+	if ((body->chunked || body->remaining >= STATS_THREAD_THRESHOLD) && cores > 1)
+	{
+		count = (cores > MAX_STATS_THREADS) ? MAX_STATS_THREADS : (int)cores;
+	}
+
+	memset(&queue, 0, sizeof(queue));
+	pthread_mutex_init(&queue.lock, NULL);
+	pthread_cond_init(&queue.filled, NULL);
+	pthread_cond_init(&queue.emptied, NULL);
+	queue.binary = binary;
+	queue.blockCount = (count == 0) ? 1 : 2 * count;
+
+	initializeStatistics(state, 1);
+
+	if (count > 0 && (tasks = malloc(count * sizeof(statisticsTask))) == NULL)
+	{
+		count = 0;
+		queue.blockCount = 1;
+	}
+
+	// Allocate the block pool
+	for (n = 0; n < queue.blockCount; n++)
+	{
+		if ((queue.blocks[n] = malloc(STATS_BLOCK_SIZE + 1)) == NULL)
+		{
+			statusCode = 500;
+		}
+
+		queue.freeBlocks[queue.freeCount++] = n;
+	}
+
+	// Start the workers
+	for (started = 0; statusCode == 200 && started < count; started++)
+	{
+		tasks[started].queue = &queue;
+		initializeStatistics(&tasks[started].state, 0x9E3779B97F4A7C15ULL * (started + 2));
+
+		if (pthread_create(&threads[started], NULL, statisticsWorker, &tasks[started]) != 0)
+		{
+			break;
+		}
+	}
+
+	if (statusCode == 200)
+	{
+		statusCode = readStatistics(body, &queue, started, state);
+	}
+
+	pthread_mutex_lock(&queue.lock);
+	queue.finished = true;
+	pthread_cond_broadcast(&queue.filled);
+	pthread_mutex_unlock(&queue.lock);
+
+	// Merge the partial states
+	for (n = 0; n < started; n++)
+	{
+		pthread_join(threads[n], NULL);
+		mergeStatistics(state, &tasks[n].state);
+	}
+
+	if (statusCode == 200 && queue.invalid)
+	{
+		statusCode = 400;
+	}
+
+	for (n = 0; n < queue.blockCount; n++)
+	{
+		free(queue.blocks[n]);
+	}
+
+	free(tasks);
+	pthread_cond_destroy(&queue.emptied);
+	pthread_cond_destroy(&queue.filled);
+	pthread_mutex_destroy(&queue.lock);
+
+	return statusCode;
+}
+
+// Streams count, sum, mean, variance and standard deviation (sample), minimum, maximum and
+// the requested quantiles of the numbers in the request body to the client as CSV
+void processStatisticsRequest(int clientIndex, requestBody *body, bool binaryInput, const double *quantiles, int quantileCount, bool chunked)
+{
+	statisticsState *state = NULL;
+	double results[MAX_STATS_QUANTILES];
+	double variance = NAN;
+	responseStream stream;
+	int statusCode = 500, n = 0;
+	bool sent = false;
+
+	if ((state = malloc(sizeof(statisticsState))) != NULL)
+	{
+		statusCode = calculateStatistics(body, binaryInput, state);
+	}
+
+	if (statusCode == 0)
+	{
+		printf("ERROR: Could not read the request body of client ID: %d!\n", clientIndex);
+		free(state);
+		closeConnection(clientIndex);
+		return;
+	}
+
+	if (statusCode == 200 && !querySketch(&state->sketch, quantiles, quantileCount, results))
+	{
+		statusCode = 500;
+	}
+
+	if (statusCode != 200)
+	{
+		free(state);
+
+		// Build HTTP response
+		buildResponseHeader(statusCode, "text/html");
+
+		// Send data
+		sendDataToClient(clientIndex, true, NULL);
+
+		return;
+	}
+
+	if (state->count > 1)
+	{
+		variance = state->m2 / (state->count - 1);
+	}
+
+	// Build HTTP response
+	buildResponseHeader(200, "text/csv");
+
+	// Stream the result
+	sent = startResponseStream(&stream, clientIndex, chunked) &&
+		   printResponseStream(&stream, "count,%lld\nsum,%.17g\nmean,%.17g\nvariance,%.17g\nstddev,%.17g\nmin,%.17g\nmax,%.17g\n",
+							   state->count, state->sum, (state->count > 0) ? state->mean : NAN, variance, sqrt(variance),
+							   (state->count > 0) ? state->minimum : NAN, (state->count > 0) ? state->maximum : NAN);
+
+	for (n = 0; sent && n < quantileCount; n++)
+	{
+		sent = printResponseStream(&stream, "q%g,%.17g\n", quantiles[n], results[n]);
+	}
+
+	if (sent && finishResponseStream(&stream))
+	{
+		printf("INFO: Statistics of %lld values sent to client OK!\n", state->count);
+	}
+	else
+	{
+		printf("ERROR: Error sending statistics to client!\n");
+	}
+
+	free(state);
+
+	// Close connection
+	closeConnection(clientIndex);
+}
+
+// Processes one frame of the binary protocol and writes the response frame to response.
+// A frame holds the little endian fields length (of the whole frame, uint32), opcode (uint16),
+// reserved (uint16) and request ID (uint32), followed by the operands (float64). Binary operations
+// take all first operands followed by all second operands. The response repeats length, opcode and
+// request ID, has the status instead of the reserved field and holds one result per operand (pair).
+// Returns the length of the response, which is never longer than the frame.
+size_t processRpcFrame(const unsigned char *frame, size_t length, unsigned char *response, double *values, double *results)
+{
+	calcOperation operation = loadLittleEndian32(frame + 4) & 0xFFFF;
+	int arity = operationArity(operation);
+	size_t payloadLength = length - RPC_HEADER_LENGTH;
+	size_t count = 0, n = 0;
+	int status = RPC_STATUS_OK, retryAfter = 0;
+
+	// Every frame is a heavy request of the client address
+	if (!takeRateToken(clientRateKey, RATE_CLASS_HEAVY, rateClock(), &retryAfter))
+	{
+		status = RPC_STATUS_RATE_LIMITED;
+	}
+	else if (arity == 0 || payloadLength % (8 * arity) != 0)
+	{
+		status = RPC_STATUS_INVALID;
+	}
+	else
+	{
+		count = payloadLength / (8 * arity);
+
+		for (n = 0; n < count * arity; n++)
+		{
+			values[n] = loadLittleEndianDouble(frame + RPC_HEADER_LENGTH + 8 * n);
+		}
+
+		// Calculate results
+		if (calculate(operation, values, values + count, results, count) != 0)
+		{
+			status = RPC_STATUS_DOMAIN_ERROR;
+		}
+
+		for (n = 0; n < count; n++)
+		{
+			storeLittleEndianDouble(response + RPC_HEADER_LENGTH + 8 * n, results[n]);
+		}
+	}
+
+	// Build response header
+	storeLittleEndian32(response, RPC_HEADER_LENGTH + 8 * count);
+	storeLittleEndian32(response + 4, (operation & 0xFFFF) | ((uint32_t)status << 16));
+	memcpy(response + 8, frame + 8, 4);
+
+	return RPC_HEADER_LENGTH + 8 * count;
+}
+
+// Serves a binary protocol connection until the client closes it. All frames received with one
+// recv are processed and their responses are sent with one write, so a client which keeps many
+// requests in flight needs few system calls. Responses are matched by request ID, clients must
+// not rely on their order.
+void processRpcClient(int clientIndex)
+{
+	unsigned char *input = malloc(RPC_BUFFER_LENGTH);
+	unsigned char *output = malloc(RPC_BUFFER_LENGTH);
+	double *values = malloc(RPC_BUFFER_LENGTH);
+	double *results = malloc(RPC_BUFFER_LENGTH);
+	size_t inputLength = 0, outputLength = 0, offset = 0, frameLength = 0;
+	ssize_t received = 0;
+	long long frames = 0;
+	bool valid = true;
+	int noDelay = 1;
+	struct timeval timeout;
+
+	// Responses are written in batches, Nagle's algorithm would only delay them
+	setsockopt(clients[clientIndex], IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+	// Idle or stalled clients must not keep their process forever
+	timeout.tv_sec = CLIENT_RECEIVE_TIMEOUT_MS / 1000;
+	timeout.tv_usec = (CLIENT_RECEIVE_TIMEOUT_MS % 1000) * 1000;
+
+	if (setsockopt(clients[clientIndex], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == -1)
+	{
+		printf("ERROR: Could not set the receive timeout of client ID: %d!\n", clientIndex);
+	}
+
+	while (valid && input != NULL && output != NULL && values != NULL && results != NULL)
+	{
+		// Receive as many frames as available
+		received = recv(clients[clientIndex], input + inputLength, RPC_BUFFER_LENGTH - inputLength, 0);
+
+		if (received == -1 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			printf("ERROR: Binary protocol client ID: %d timed out!\n", clientIndex);
+			break;
+		}
+
+		if (received <= 0)
+		{
+			break;
+		}
+
+		inputLength += received;
+
+		// Process all complete frames
+		for (offset = 0; inputLength - offset >= RPC_HEADER_LENGTH; offset += frameLength, frames++)
+		{
+			frameLength = loadLittleEndian32(input + offset);
+
+			if (frameLength < RPC_HEADER_LENGTH || frameLength > RPC_BUFFER_LENGTH)
+			{
+				printf("ERROR: Invalid binary protocol frame length %zu of client ID: %d!\n", frameLength, clientIndex);
+				valid = false;
+				break;
+			}
+
+			if (inputLength - offset < frameLength)
+			{
+				break;
+			}
+
+			// Make room for the response
+			if (outputLength + frameLength > RPC_BUFFER_LENGTH)
+			{
+				valid = writeAllToClient(clientIndex, (char *)output, outputLength);
+				outputLength = 0;
+			}
+
+			outputLength += processRpcFrame(input + offset, frameLength, output + outputLength, values, results);
+		}
+
+		// Keep the incomplete frame for the next recv
+		memmove(input, input + offset, inputLength - offset);
+		inputLength -= offset;
+
+		// Send the responses of the batch, also those in front of an invalid frame
+		if (outputLength > 0 && !writeAllToClient(clientIndex, (char *)output, outputLength))
+		{
+			valid = false;
+		}
+
+		outputLength = 0;
+	}
+
+	printf("INFO: Binary protocol client ID: %d processed %lld frames\n", clientIndex, frames);
+
+	free(input);
+	free(output);
+	free(values);
+	free(results);
+
+	// Close connection
+	closeConnection(clientIndex);
+}
+
+// SHA-1 message digest (FIPS 180-4), needed for the WebSocket handshake only
+void sha1(const unsigned char *data, size_t length, unsigned char digest[20])
+{
+	uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+	uint32_t words[80], a, b, c, d, e, f, k, temp;
+	unsigned char block[64];
+	uint64_t bitLength = (uint64_t)length * 8;
+	size_t offset = 0, blockLength = 0;
+	bool padded = false, lengthAdded = false;
+	int n;
+
+	while (!lengthAdded)
+	{
+		// Take the next block, the last blocks get the padding and the message length
+		blockLength = (length - offset < 64) ? length - offset : 64;
+		memcpy(block, data + offset, blockLength);
+		offset += blockLength;
+
+		if (blockLength < 64)
+		{
+			memset(block + blockLength, 0, 64 - blockLength);
+
+			if (!padded)
+			{
+				block[blockLength] = 0x80;
+				padded = true;
+				blockLength++;
+			}
+
+			if (blockLength <= 56)
+			{
+				for (n = 0; n < 8; n++)
+				{
+					block[63 - n] = (unsigned char)(bitLength >> (8 * n));
+				}
+
+				lengthAdded = true;
+			}
+		}
+
+		for (n = 0; n < 16; n++)
+		{
+			words[n] = ((uint32_t)block[4 * n] << 24) | ((uint32_t)block[4 * n + 1] << 16) | ((uint32_t)block[4 * n + 2] << 8) | block[4 * n + 3];
+		}
+
+		for (n = 16; n < 80; n++)
+		{
+			temp = words[n - 3] ^ words[n - 8] ^ words[n - 14] ^ words[n - 16];
+			words[n] = (temp << 1) | (temp >> 31);
+		}
+
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+
+		for (n = 0; n < 80; n++)
+		{
+			if (n < 20)
+			{
+				f = (b & c) | (~b & d);
+				k = 0x5A827999;
+			}
+			else if (n < 40)
+			{
+				f = b ^ c ^ d;
+				k = 0x6ED9EBA1;
+			}
+			else if (n < 60)
+			{
+				f = (b & c) | (b & d) | (c & d);
+				k = 0x8F1BBCDC;
+			}
+			else
+			{
+				f = b ^ c ^ d;
+				k = 0xCA62C1D6;
+			}
+
+			temp = ((a << 5) | (a >> 27)) + f + e + k + words[n];
+			e = d;
+			d = c;
+			c = (b << 30) | (b >> 2);
+			b = a;
+			a = temp;
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+	}
+
+	for (n = 0; n < 20; n++)
+	{
+		digest[n] = (unsigned char)(state[n / 4] >> (24 - 8 * (n % 4)));
+	}
+}
+
+// Base64 encoding (RFC 4648) with padding, result needs 4 * ((length + 2) / 3) + 1 characters
+void base64Encode(const unsigned char *data, size_t length, char *result)
+{
+	const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	uint32_t group;
+	size_t n;
+
+	for (n = 0; n < length; n += 3)
+	{
+		group = (uint32_t)data[n] << 16;
+		group |= (n + 1 < length) ? (uint32_t)data[n + 1] << 8 : 0;
+		group |= (n + 2 < length) ? data[n + 2] : 0;
+
+		*result++ = alphabet[(group >> 18) & 0x3F];
+		*result++ = alphabet[(group >> 12) & 0x3F];
+		*result++ = (n + 1 < length) ? alphabet[(group >> 6) & 0x3F] : '=';
+		*result++ = (n + 2 < length) ? alphabet[group & 0x3F] : '=';
+	}
+
+	*result = '\0';
+}
+
+// Sends a single unfragmented WebSocket frame (server frames are not masked)
+bool sendWebSocketFrame(webSocketSession *session, int opcode, const void *payload, size_t length)
+{
+	size_t headerLength = 2;
+	int n;
+
+	session->output[0] = 0x80 | opcode;
+
+	if (length < 126)
+	{
+		session->output[1] = (unsigned char)length;
+	}
+	else if (length < 65536)
+	{
+		session->output[1] = 126;
+		session->output[2] = (unsigned char)(length >> 8);
+		session->output[3] = (unsigned char)length;
+		headerLength = 4;
+	}
+	else
+	{
+		session->output[1] = 127;
+
+		for (n = 0; n < 8; n++)
+		{
+			session->output[9 - n] = (unsigned char)((uint64_t)length >> (8 * n));
+		}
+
+		headerLength = 10;
+	}
+
+	memcpy(session->output + headerLength, payload, length);
+
+	return writeAllToClient(session->clientIndex, (char *)session->output, headerLength + length);
+}
+
+// Sends a close frame with the status code (1000 normal, 1002 protocol error, 1007 invalid data, 1009 too big,
+// 1013 try again later)
+bool closeWebSocket(webSocketSession *session, int statusCode)
+{
+	unsigned char payload[2] = {(unsigned char)(statusCode >> 8), (unsigned char)statusCode};
+
+	return sendWebSocketFrame(session, 0x8, payload, 2);
+}
+
+// Parses a calculation command in the syntax of the HTTP endpoints: /calc/<add|sub|mul|div|mod>/<Number 1>/<Number 2>,
+// /calc/sqrt/<Number>, /calc/func/<sin|cos|tan>/<Number> or /serv/random/<Number>[/<Interval>]. The optional interval
+// (milliseconds) of the random number service starts a stream, it is 0 otherwise. Returns false for invalid commands.
+bool parseCalcCommand(char *command, calcOperation *operation, double *operands, long *interval)
+{
+	const char *names[] = {"add", "sub", "mul", "div", "mod"};
+	const calcOperation operations[] = {OPERATION_ADD, OPERATION_SUB, OPERATION_MUL, OPERATION_DIV, OPERATION_MOD};
+	char *tokens[4] = {NULL, };
+	char *token = NULL, *savePointer = NULL, *end = NULL;
+	int count = 0, n = 0;
+
+	for (token = strtok_r(command, "/", &savePointer); token != NULL; token = strtok_r(NULL, "/", &savePointer))
+	{
+		if (count == 4)
+		{
+			return false;
+		}
+
+		tokens[count++] = token;
+	}
+
+	if (count < 3)
+	{
+		return false;
+	}
+
+	*interval = 0;
+
+	if (strcmp(tokens[0], "serv") == 0 && strcmp(tokens[1], "random") == 0 && convertToDouble(tokens[2], &operands[0]))
+	{
+		*operation = OPERATION_RANDOM;
+
+		if (count == 4)
+		{
+			*interval = strtol(tokens[3], &end, 10);
+			return *end == '\0' && *interval >= MIN_WS_STREAM_INTERVAL;
+		}
+
+		return true;
+	}
+
+	if (strcmp(tokens[0], "calc") != 0)
+	{
+		return false;
+	}
+
+	if (count == 3 && strcmp(tokens[1], "sqrt") == 0)
+	{
+		*operation = OPERATION_SQRT;
+		return convertToDouble(tokens[2], &operands[0]);
+	}
+
+	if (count == 4 && strcmp(tokens[1], "func") == 0)
+	{
+		if (strcmp(tokens[2], "sin") == 0)
+		{
+			*operation = OPERATION_SIN;
+		}
+		else if (strcmp(tokens[2], "cos") == 0)
+		{
+			*operation = OPERATION_COS;
+		}
+		else if (strcmp(tokens[2], "tan") == 0)
+		{
+			*operation = OPERATION_TAN;
+		}
+		else
+		{
+			return false;
+		}
+
+		return convertToDouble(tokens[3], &operands[0]);
+	}
+
+	for (n = 0; count == 4 && n < 5; n++)
+	{
+		if (strcmp(tokens[1], names[n]) == 0)
+		{
+			*operation = operations[n];
+			return convertToDouble(tokens[2], &operands[0]) && convertToDouble(tokens[3], &operands[1]);
+		}
+	}
+
+	return false;
+}
+
+// Checks that data is well-formed UTF-8: no overlong forms, surrogates or code points above U+10FFFF
+bool isValidUtf8(const unsigned char *data, size_t length)
+{
+	size_t n = 0, count = 0, k = 0;
+	unsigned char lower = 0x80, upper = 0xBF;
+
+	while (n < length)
+	{
+		if (data[n] < 0x80)
+		{
+			n++;
+			continue;
+		}
+
+		// Number of continuation bytes and the range of the first one
+		lower = 0x80;
+		upper = 0xBF;
+
+		if (data[n] >= 0xC2 && data[n] <= 0xDF)
+		{
+			count = 1;
+		}
+		else if (data[n] >= 0xE0 && data[n] <= 0xEF)
+		{
+			count = 2;
+			lower = (data[n] == 0xE0) ? 0xA0 : 0x80;
+			upper = (data[n] == 0xED) ? 0x9F : 0xBF;
+		}
+		else if (data[n] >= 0xF0 && data[n] <= 0xF4)
+		{
+			count = 3;
+			lower = (data[n] == 0xF0) ? 0x90 : 0x80;
+			upper = (data[n] == 0xF4) ? 0x8F : 0xBF;
+		}
+		else
+		{
+			return false;
+		}
+
+		if (length - n <= count || data[n + 1] < lower || data[n + 1] > upper)
+		{
+			return false;
+		}
+
+		for (k = 2; k <= count; k++)
+		{
+			if ((data[n + k] & 0xC0) != 0x80)
+			{
+				return false;
+			}
+		}
+
+		n += count + 1;
+	}
+
+	return true;
+}
+
+// Answers a text message with one command: the reply is the command followed by the result
+// or "error". "stop" ends the stream of random numbers.
+bool processWebSocketText(webSocketSession *session)
+{
+	char command[MAX_URI_LENGTH + 1];
+	char reply[2 * MAX_URI_LENGTH];
+	calcOperation operation = OPERATION_ADD;
+	double operands[2] = {0, 0}, result = 0;
+	long interval = 0;
+
+	if (session->messageLength > MAX_URI_LENGTH)
+	{
+		return sendWebSocketFrame(session, 0x1, "error", 5);
+	}
+
+	memcpy(command, session->message, session->messageLength);
+	command[session->messageLength] = '\0';
+
+	if (strcmp(command, "stop") == 0)
+	{
+		session->streaming = false;
+		return sendWebSocketFrame(session, 0x1, command, 4);
+	}
+
+	snprintf(reply, sizeof(reply), "%s ", command);
+
+	if (!parseCalcCommand(command, &operation, operands, &interval))
+	{
+		strcat(reply, "error");
+	}
+	else if (interval > 0)
+	{
+		// Start the stream, the first number is pushed immediately
+		session->streaming = true;
+		session->streamRange = operands[0];
+		session->streamInterval = interval;
+		clock_gettime(CLOCK_MONOTONIC, &session->nextPush);
+
+		return true;
+	}
+	else if (calculate(operation, &operands[0], &operands[1], &result, 1) != 0)
+	{
+		strcat(reply, "error");
+	}
+	else
+	{
+		snprintf(reply + strlen(reply), sizeof(reply) - strlen(reply), "%.17g", result);
+	}
+
+	return sendWebSocketFrame(session, 0x1, reply, strlen(reply));
+}
+
+// Answers a binary message, which holds frames of the binary protocol, with their response frames
+bool processWebSocketBinary(webSocketSession *session)
+{
+	size_t offset = 0, replyLength = 0, frameLength = 0;
+
+	while (offset < session->messageLength)
+	{
+		frameLength = (session->messageLength - offset >= 4) ? loadLittleEndian32(session->message + offset) : 0;
+
+		if (frameLength < RPC_HEADER_LENGTH || frameLength > session->messageLength - offset)
+		{
+			closeWebSocket(session, 1007);
+			return false;
+		}
+
+		replyLength += processRpcFrame(session->message + offset, frameLength, session->reply + replyLength, session->values, session->results);
+		offset += frameLength;
+	}
+
+	return sendWebSocketFrame(session, 0x2, session->reply, replyLength);
+}
+
+// Pushes the next random number of the stream
+bool pushWebSocketStream(webSocketSession *session)
+{
+	char reply[2 * MAX_URI_LENGTH];
+	double result = 0;
+
+	calculate(OPERATION_RANDOM, &session->streamRange, NULL, &result, 1);
+	snprintf(reply, sizeof(reply), "/serv/random/%.17g %.17g", session->streamRange, result);
+
+	// Schedule the next push
+	session->nextPush.tv_sec += session->streamInterval / 1000;
+	session->nextPush.tv_nsec += (session->streamInterval % 1000) * 1000000L;
+
+	if (session->nextPush.tv_nsec >= 1000000000L)
+	{
+		session->nextPush.tv_sec++;
+		session->nextPush.tv_nsec -= 1000000000L;
+	}
+
+	return sendWebSocketFrame(session, 0x1, reply, strlen(reply));
+}
+
+// Handles one received frame: control frames are answered at once, data frames are
+// assembled into a message. Returns false if the session ends.
+bool processWebSocketFrame(webSocketSession *session, int opcode, bool final, unsigned char *payload, size_t length)
+{
+	int retryAfter = 0;
+
+	// Control frames may arrive between the fragments of a message
+	if (opcode & 0x8)
+	{
+		if (!final || length > MAX_WS_CONTROL_LENGTH)
+		{
+			closeWebSocket(session, 1002);
+			return false;
+		}
+
+		switch (opcode)
+		{
+			case 0x8:
+				// Close: echo the status code, the reason has to be UTF-8
+				if (length > 2 && !isValidUtf8(payload + 2, length - 2))
+				{
+					closeWebSocket(session, 1007);
+					return false;
+				}
+
+				sendWebSocketFrame(session, 0x8, payload, (length >= 2) ? 2 : 0);
+				return false;
+
+			case 0x9:
+				return sendWebSocketFrame(session, 0xA, payload, length);
+
+			case 0xA:
+				return true;
+
+			default:
+				closeWebSocket(session, 1002);
+				return false;
+		}
+	}
+
+	// A continuation needs a started message, a new message needs a finished one
+	if ((opcode == 0x0) != (session->messageOpcode != 0) || opcode > 0x2)
+	{
+		closeWebSocket(session, 1002);
+		return false;
+	}
+
+	if (session->messageLength + length > MAX_WS_MESSAGE_LENGTH)
+	{
+		closeWebSocket(session, 1009);
+		return false;
+	}
+
+	if (opcode != 0x0)
+	{
+		session->messageOpcode = opcode;
+	}
+
+	memcpy(session->message + session->messageLength, payload, length);
+	session->messageLength += length;
+
+	if (!final)
+	{
+		return true;
+	}
+
+	opcode = session->messageOpcode;
+	session->messageOpcode = 0;
+
+	// Text messages have to be UTF-8 across all of their fragments
+	if (opcode == 0x1 && !isValidUtf8(session->message, session->messageLength))
+	{
+		closeWebSocket(session, 1007);
+		return false;
+	}
+
+	// A text message is a heavy request of the client address, binary messages are charged per frame
+	if (opcode == 0x1 && !takeRateToken(clientRateKey, RATE_CLASS_HEAVY, rateClock(), &retryAfter))
+	{
+		printf("INFO: Rate limit exceeded by WebSocket client!\n");
+		closeWebSocket(session, 1013);
+		return false;
+	}
+
+	if (opcode == 0x1 ? !processWebSocketText(session) : !processWebSocketBinary(session))
+	{
+		return false;
+	}
+
+	session->messageLength = 0;
+
+	return true;
+}
+
+// Parses all complete frames in the input buffer. Returns false if the session ends.
+bool processWebSocketInput(webSocketSession *session)
+{
+	unsigned char *frame = session->input;
+	size_t available = session->inputLength;
+	size_t headerLength = 0, n = 0;
+	uint64_t length = 0;
+	bool result = true;
+
+	while (result && available >= 2)
+	{
+		headerLength = 2;
+		length = frame[1] & 0x7F;
+
+		// Extended payload length (big endian)
+		if (length >= 126)
+		{
+			headerLength = (length == 126) ? 4 : 10;
+
+			if (available < headerLength)
+			{
+				break;
+			}
+
+			for (n = 2, length = 0; n < headerLength; n++)
+			{
+				length = (length << 8) | frame[n];
+			}
+		}
+
+		// Client frames must be masked, the reserved bits must not be set
+		if ((frame[1] & 0x80) == 0 || (frame[0] & 0x70) != 0)
+		{
+			closeWebSocket(session, 1002);
+			return false;
+		}
+
+		if (length > MAX_WS_MESSAGE_LENGTH)
+		{
+			closeWebSocket(session, 1009);
+			return false;
+		}
+
+		headerLength += 4;
+
+		if (available < headerLength + length)
+		{
+			break;
+		}
+
+		// Unmask the payload in place
+		for (n = 0; n < length; n++)
+		{
+			frame[headerLength + n] ^= frame[headerLength - 4 + (n & 3)];
+		}
+
+		result = processWebSocketFrame(session, frame[0] & 0x0F, (frame[0] & 0x80) != 0, frame + headerLength, length);
+
+		frame += headerLength + length;
+		available -= headerLength + length;
+	}
+
+	// Keep the incomplete frame for the next recv
+	memmove(session->input, frame, available);
+	session->inputLength = available;
+
+	return result;
+}
+
+// Completes the WebSocket handshake and serves the session until one side closes it. Text messages
+// hold calculation commands, binary messages hold frames of the binary protocol.
+void processWebSocketClient(int clientIndex, const char *key, const char *pending, size_t pendingLength)
+{
+	const char handshakeTemplate[] = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: %s\r\nServer: KnoblHyperActiveServer(1.0)\r\n\r\n";
+	char handshakeKey[MAX_HEADER_VALUE_LENGTH + sizeof(WS_GUID)];
+	unsigned char digest[20];
+	char accept[32];
+	webSocketSession session;
+	struct pollfd client;
+	struct timespec now;
+	long timeout = 0;
+	ssize_t received = 0;
+	bool running = true;
+
+	memset(&session, 0, sizeof(session));
+	session.clientIndex = clientIndex;
+	session.input = malloc(MAX_WS_MESSAGE_LENGTH + MAX_WS_HEADER_LENGTH);
+	session.message = malloc(MAX_WS_MESSAGE_LENGTH);
+	session.output = malloc(MAX_WS_MESSAGE_LENGTH + MAX_WS_HEADER_LENGTH);
+	session.reply = malloc(MAX_WS_MESSAGE_LENGTH);
+	session.values = malloc(MAX_WS_MESSAGE_LENGTH);
+	session.results = malloc(MAX_WS_MESSAGE_LENGTH);
+
+	// Accept key: base64 of the SHA-1 of the client key and the WebSocket GUID
+	snprintf(handshakeKey, sizeof(handshakeKey), "%s%s", key, WS_GUID);
+	sha1((const unsigned char *)handshakeKey, strlen(handshakeKey), digest);
+	base64Encode(digest, 20, accept);
+	snprintf(responseHeaderBuffer, MAX_RESPONSE_LENGTH, handshakeTemplate, accept);
+
+	printResponseHeaderBuffer();
+
+	if (session.input == NULL || session.message == NULL || session.output == NULL || session.reply == NULL ||
+		session.values == NULL || session.results == NULL || pendingLength > MAX_WS_MESSAGE_LENGTH + MAX_WS_HEADER_LENGTH ||
+		!writeAllToClient(clientIndex, responseHeaderBuffer, strlen(responseHeaderBuffer)))
+	{
+		printf("ERROR: WebSocket handshake with client ID: %d failed!\n", clientIndex);
+		running = false;
+	}
+	else
+	{
+		// Frames sent together with the handshake
+		memcpy(session.input, pending, pendingLength);
+		session.inputLength = pendingLength;
+		running = processWebSocketInput(&session);
+	}
+
+	// Every session gets its own random numbers
+	srand(time(NULL) ^ getpid());
+
+	client.fd = clients[clientIndex];
+	client.events = POLLIN;
+
+	while (running)
+	{
+		// Wait for frames or the next push of the stream
+		timeout = -1;
+
+		if (session.streaming)
+		{
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			timeout = (session.nextPush.tv_sec - now.tv_sec) * 1000 + (session.nextPush.tv_nsec - now.tv_nsec) / 1000000;
+
+			if (timeout <= 0)
+			{
+				running = pushWebSocketStream(&session);
+				continue;
+			}
+		}
+
+		if (poll(&client, 1, timeout) == -1)
+		{
+			running = (errno == EINTR);
+			continue;
+		}
+
+		if (client.revents == 0)
+		{
+			continue;
+		}
+
+		received = recv(clients[clientIndex], session.input + session.inputLength, MAX_WS_MESSAGE_LENGTH + MAX_WS_HEADER_LENGTH - session.inputLength, 0);
+
+		if (received <= 0)
+		{
+			running = (received == -1 && errno == EINTR);
+			continue;
+		}
+
+		session.inputLength += received;
+		running = processWebSocketInput(&session);
+	}
+
+	printf("INFO: WebSocket session of client ID: %d closed\n", clientIndex);
+
+	free(session.input);
+	free(session.message);
+	free(session.output);
+	free(session.reply);
+	free(session.values);
+	free(session.results);
+
+	// Close connection
+	closeConnection(clientIndex);
+}
+
+// Process client connection
+void processClient(int clientIndex)
+{
+    char *requestMethod, *requestURL, *protocolVersion, *headerEnd;
+	char clientRequestBuffer[MAX_REQUEST_LENGTH] = {0, };
+	char headerValue[MAX_HEADER_VALUE_LENGTH] = {0, };
+	char contentType[MAX_HEADER_VALUE_LENGTH] = {0, };
+	char accept[MAX_HEADER_VALUE_LENGTH] = {0, };
+	char webSocketKey[MAX_HEADER_VALUE_LENGTH] = {0, };
+	int n = 0, bytesRead = 0, received = 0, retryAfter = 0;
+	int encodings[ENCODINGS] = {1000, 0, 0};
+	bool sendPayload = false, isPost = false, isUpgrade = false, allowed = true;
+	long long contentLength = -1;
+	requestBody body = {.clientIndex = clientIndex, .pending = NULL, .pendingLength = 0, .remaining = 0, .chunked = false, .finished = false};
+	uint64_t traceStart = 0;
+	size_t terminatorLength = 0;
+	struct timeval timeout;
+
+	// Sample the request for tracing
+	traceStartRequest();
+	traceStart = traceBegin();
+
+	// Idle or slow clients must not keep the process forever
+	timeout.tv_sec = CLIENT_RECEIVE_TIMEOUT_MS / 1000;
+	timeout.tv_usec = (CLIENT_RECEIVE_TIMEOUT_MS % 1000) * 1000;
+
+	if (setsockopt(clients[clientIndex], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == -1)
+	{
+		printf("ERROR: Could not set the receive timeout of client ID: %d!\n", clientIndex);
+	}
+
+	// Receive client request until the end of the header (the last byte is kept as terminator)
+	do
+	{
+		received = recv(clients[clientIndex], &clientRequestBuffer[bytesRead], MAX_REQUEST_LENGTH - 1 - bytesRead, 0);
+
+		if (received > 0)
+		{
+			bytesRead += received;
+		}
+	}
+	while (received > 0 && findHeaderEnd(clientRequestBuffer, &terminatorLength) == NULL && bytesRead < MAX_REQUEST_LENGTH - 1);
+
+	if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	{
+		printf("ERROR: Receive timeout client ID: %d!\n", clientIndex);
+
+		// Build HTTP response
+		buildResponseHeader(408, "text/html");
+
+		// Send data
+		sendDataToClient(clientIndex, false, NULL);
+
+		return;
+	}
+
+	if (received < 0 && bytesRead == 0)
+	{
+		bytesRead = -1;
+	}
+
+    if (bytesRead < 0)
+	{
+        printf("ERROR: Receive error client ID: %d!\n", clientIndex);
 		closeConnection(clientIndex);
 		return;
 	}
@@ -516,98 +7396,403 @@ void processClient(int clientIndex)
 		return;
 	}
 
+	traceEnd(TRACE_RECV, traceStart);
+	traceStart = traceBegin();
+
     // Data received
 	printf("------HTTP REQUEST------\n%s\n\n", clientRequestBuffer);
 
-	// Parse request method
-	requestMethod = strtok(clientRequestBuffer, " \t\r\n");
+	// Read the request headers before the request line gets tokenized
+	if (findRequestHeader(clientRequestBuffer, "Content-Length", headerValue, MAX_HEADER_VALUE_LENGTH))
+	{
+		contentLength = strtoll(headerValue, NULL, 10);
+	}
+
+	// A chunked body has no length in advance
+	if (findRequestHeader(clientRequestBuffer, "Transfer-Encoding", headerValue, MAX_HEADER_VALUE_LENGTH) && strstr(headerValue, "chunked") != NULL)
+	{
+		body.chunked = true;
+		contentLength = -1;
+	}
+
+	findRequestHeader(clientRequestBuffer, "Content-Type", contentType, MAX_HEADER_VALUE_LENGTH);
+	findRequestHeader(clientRequestBuffer, "Accept", accept, MAX_HEADER_VALUE_LENGTH);
+
+	if (findRequestHeader(clientRequestBuffer, "Accept-Encoding", headerValue, MAX_HEADER_VALUE_LENGTH))
+	{
+		parseAcceptEncoding(headerValue, encodings);
+	}
+
+	// WebSocket upgrade (version 13)
+	if (findRequestHeader(clientRequestBuffer, "Upgrade", headerValue, MAX_HEADER_VALUE_LENGTH) && strcasecmp(headerValue, "websocket") == 0 &&
+		findRequestHeader(clientRequestBuffer, "Connection", headerValue, MAX_HEADER_VALUE_LENGTH) && strcasestr(headerValue, "upgrade") != NULL &&
+		findRequestHeader(clientRequestBuffer, "Sec-WebSocket-Version", headerValue, MAX_HEADER_VALUE_LENGTH) && strcmp(headerValue, "13") == 0 &&
+		findRequestHeader(clientRequestBuffer, "Sec-WebSocket-Key", webSocketKey, MAX_HEADER_VALUE_LENGTH))
+	{
+		isUpgrade = true;
+	}
+
+	// The body starts behind the empty line, a part of it might have been received already
+	if ((headerEnd = findHeaderEnd(clientRequestBuffer, &terminatorLength)) != NULL)
+	{
+		body.pending = headerEnd + terminatorLength;
+		body.pendingLength = bytesRead - (body.pending - clientRequestBuffer);
+	}
+
+	// Parse request method
+	requestMethod = strtok(clientRequestBuffer, " \t\r\n");
+
+	// Check request method
+	if (requestMethod == NULL)
+	{
+		printf("ERROR: HTTP REQUEST not found!");
+		buildResponseHeader(405, "text/html");
+		sendDataToClient(clientIndex, false, NULL);
+		return;
+	}
+	else if (strncmp(requestMethod, "GET\0", 4) == 0)
+	{
+		sendPayload = true;
+	}
+	else if (strncmp(requestMethod, "HEAD\0", 5) == 0)
+    {
+		sendPayload = false;
+	}
+	else if (strncmp(requestMethod, "POST\0", 5) == 0)
+	{
+		sendPayload = true;
+		isPost = true;
+	}
+	else
+	{
+		buildResponseHeader(405, "text/html");
+		sendDataToClient(clientIndex, false, NULL);
+		return;
+	}
+
+	// Parse requestURL
+    requestURL = strtok(NULL, " \t");
+
+	// Check requestURL
+	if (requestURL == NULL)
+	{
+		buildResponseHeader(400, "text/html");
+		sendDataToClient(clientIndex, false, NULL);
+		return;
+	}
+
+	// Parse protocolVersion
+    protocolVersion = strtok(NULL, " \t\r\n");
+
+	// Check protocolVersion
+	if (requestURL == NULL)
+	{
+		buildResponseHeader(400, "text/html");
+		sendDataToClient(clientIndex, false, NULL);
+		return;
+	}
+
+	// Check URL length, the arbitrary-precision operations take long numbers
+	if (strlen(requestURL) > MAX_URI_LENGTH && strncmp(requestURL, "/calc/big/", 10) != 0)
+	{
+		buildResponseHeader(414, "text/html");
+		sendDataToClient(clientIndex, sendPayload, NULL);
+		return;
+	}
+
+	printf("------REQUEST DATA:------\nrequestMethod = '%s'\nrequestURL = '%s'\nprotocolVersion = '%s'\n\n", requestMethod, requestURL, protocolVersion);
+
+	// Check HTTP protocol version
+	if (strncmp(protocolVersion, "HTTP/1.0", 8) != 0 && strncmp(protocolVersion, "HTTP/1.1", 8) != 0)
+    {
+		// Wrong HTTP version or bad request
+		write(clients[clientIndex], "HTTP/1.0 400 Bad Request\r\n", 26);
+    }
+    else
+    {
+		// Check and remove trailing "/"
+		for (n = strlen(requestURL) - 1; n > 0; n--)
+		{
+			if (requestURL[n] == '/')
+			{
+				requestURL[n] = '\0';
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		// Check URL
+		if ((strncmp(requestURL, "/\0", 2) == 0) ||	(strncmp(requestURL, "/index.htm\0", 11) == 0))
+		{
+			requestURL = "/index.html";
+		}
+
+		printf("------REQUEST DATA (TRAILED)------\nrequestMethod = '%s'\nrequestURL = '%s'\nprotocolVersion = '%s'\n\n", requestMethod, requestURL, protocolVersion);
+
+		if (traceActive)
+		{
+			snprintf(currentTrace.url, MAX_URI_LENGTH, "%s %s", requestMethod, requestURL);
+		}
+
+		traceEnd(TRACE_PARSE, traceStart);
+		traceStart = traceBegin();
+
+		// Limit the request rate of the client address per route class
+		allowed = takeRateToken(clientRateKey, routeRateClass(requestURL), rateClock(), &retryAfter);
+		traceEnd(TRACE_ROUTE, traceStart);
+
+		if (!allowed)
+		{
+			printf("INFO: Rate limit exceeded by client ID: %d!\n", clientIndex);
+
+			// Build HTTP response
+			buildResponseHeader(429, "text/html");
+			snprintf(&responseHeaderBuffer[strlen(responseHeaderBuffer)], MAX_RESPONSE_LENGTH - strlen(responseHeaderBuffer), "Retry-After: %d\r\n", retryAfter);
+
+			// Send data
+			sendDataToClient(clientIndex, sendPayload, NULL);
+
+			return;
+		}
+
+		// HANDLER
+		if (strncmp(requestURL, "/calc/matrix", 12) == 0)
+		{
+			// HANDLING: The matrix operation <Operation> of the two matrices in the request body
+			requestURL += 12;
+
+			if (!isPost)
+			{
+				// Build HTTP response
+				buildResponseHeader(405, "text/html");
+			}
+			else if (*requestURL == '\0')
+			{
+				// Build HTTP response
+				buildResponseHeader(400, "text/html");
+			}
+			else if (contentLength < 0)
+			{
+				// Build HTTP response
+				buildResponseHeader(411, "text/html");
+			}
+			else if (contentLength > MAX_MATRIX_BODY_LENGTH)
+			{
+				// Build HTTP response
+				buildResponseHeader(413, "text/html");
+			}
+			else
+			{
+				body.remaining = contentLength;
+
+				processMatrixRequest(clientIndex, ++requestURL, &body, strncasecmp(contentType, "application/octet-stream", 24) == 0,
+									 strstr(accept, "application/octet-stream") != NULL, strncmp(protocolVersion, "HTTP/1.1", 8) == 0);
+				return;
+			}
+
+			// Send data
+			sendDataToClient(clientIndex, sendPayload, NULL);
+
+			return;
+		}
+		else if (strncmp(requestURL, "/admin/trace\0", 13) == 0)
+		{
+			// HANDLING: The sampled request traces as Chrome trace event JSON (local clients only)
+			if (isPost)
+			{
+				// Build HTTP response
+				buildResponseHeader(405, "text/html");
+			}
+			else if (traceTable == NULL)
+			{
+				// Build HTTP response
+				buildResponseHeader(404, "text/html");
+			}
+			else if (!isLocalAddress(&clientAddress))
+			{
+				// Build HTTP response
+				buildResponseHeader(403, "text/html");
+			}
+			else
+			{
+				sendTraceToClient(clientIndex, sendPayload, strncmp(protocolVersion, "HTTP/1.1", 8) == 0);
+				return;
+			}
+
+			// Send data
+			sendDataToClient(clientIndex, sendPayload, NULL);
+
+			return;
+		}
+		else if (strncmp(requestURL, "/ws\0", 4) == 0)
+		{
+			// HANDLING: WebSocket session for calculation commands and pushed random numbers
+			if (isPost || !sendPayload)
+			{
+				// Build HTTP response
+				buildResponseHeader(405, "text/html");
+			}
+			else if (!isUpgrade)
+			{
+				// Build HTTP response
+				buildResponseHeader(400, "text/html");
+			}
+			else
+			{
+				processWebSocketClient(clientIndex, webSocketKey, body.pending, body.pendingLength);
+				return;
+			}
+
+			// Send data
+			sendDataToClient(clientIndex, sendPayload, NULL);
+
+			return;
+		}
+		else if (strncmp(requestURL, "/calc/stats", 11) == 0)
+		{
+			// HANDLING: Count, sum, mean, variance, minimum, maximum and the quantiles <Quantile 1>/<Quantile 2>/... of the numbers in the request body
+			const double defaultQuantiles[] = {0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99};
+			double quantiles[MAX_STATS_QUANTILES];
+			int quantileCount = 0;
+			bool valid = true;
+			char *token;
 
-	// Check request method
-	if (requestMethod == NULL)
-	{
-		printf("ERROR: HTTP REQUEST not found!");
-		buildResponseHeader(405, "text/html");
-		sendDataToClient(clientIndex, false, NULL);
-		return;
-	}
-	else if (strncmp(requestMethod, "GET\0", 4) == 0)
-	{
-		sendPayload = true;
-	}
-	else if (strncmp(requestMethod, "HEAD\0", 5) == 0)
-    {
-		sendPayload = false;
-	}
-	else
-	{
-		buildResponseHeader(405, "text/html");
-		sendDataToClient(clientIndex, false, NULL);
-		return;
-	}
+			// Move pointer to the start of the quantiles
+			requestURL += 11;
 
-	// Parse requestURL
-    requestURL = strtok(NULL, " \t");
+			if (*requestURL != '\0' && *requestURL != '/')
+			{
+				valid = false;
+			}
 
-	// Check requestURL
-	if (requestURL == NULL)
-	{
-		buildResponseHeader(400, "text/html");
-		sendDataToClient(clientIndex, false, NULL);
-		return;
-	}
+			// Parse the requested quantiles
+			for (token = strtok(requestURL, "/"); valid && token != NULL; token = strtok(NULL, "/"))
+			{
+				valid = quantileCount < MAX_STATS_QUANTILES && convertToDouble(token, &quantiles[quantileCount]) &&
+						quantiles[quantileCount] >= 0 && quantiles[quantileCount] <= 1;
+				quantileCount++;
+			}
 
-	// Parse protocolVersion
-    protocolVersion = strtok(NULL, " \t\r\n");
+			if (quantileCount == 0)
+			{
+				quantileCount = sizeof(defaultQuantiles) / sizeof(defaultQuantiles[0]);
+				memcpy(quantiles, defaultQuantiles, sizeof(defaultQuantiles));
+			}
 
-	// Check protocolVersion
-	if (requestURL == NULL)
-	{
-		buildResponseHeader(400, "text/html");
-		sendDataToClient(clientIndex, false, NULL);
-		return;
-	}
+			if (!isPost)
+			{
+				// Build HTTP response
+				buildResponseHeader(405, "text/html");
+			}
+			else if (!valid)
+			{
+				// Build HTTP response
+				buildResponseHeader(400, "text/html");
+			}
+			else if (contentLength < 0 && !body.chunked)
+			{
+				// Build HTTP response
+				buildResponseHeader(411, "text/html");
+			}
+			else
+			{
+				if (!body.chunked)
+				{
+					body.remaining = contentLength;
+				}
 
-	// Check URL length
-	if (strlen(requestURL) > MAX_URI_LENGTH)
-	{
-		buildResponseHeader(414, "text/html");
-		sendDataToClient(clientIndex, sendPayload, NULL);
-		return;
-	}
+				processStatisticsRequest(clientIndex, &body, strncasecmp(contentType, "application/octet-stream", 24) == 0,
+										 quantiles, quantileCount, strncmp(protocolVersion, "HTTP/1.1", 8) == 0);
+				return;
+			}
 
-	printf("------REQUEST DATA:------\nrequestMethod = '%s'\nrequestURL = '%s'\nprotocolVersion = '%s'\n\n", requestMethod, requestURL, protocolVersion);
+			// Send data
+			sendDataToClient(clientIndex, sendPayload, NULL);
 
-	// Check HTTP protocol version
-	if (strncmp(protocolVersion, "HTTP/1.0", 8) != 0 && strncmp(protocolVersion, "HTTP/1.1", 8) != 0)
-    {
-		// Wrong HTTP version or bad request
-		write(clients[clientIndex], "HTTP/1.0 400 Bad Request\r\n", 26);
-    }
-    else
-    {
-		// Check and remove trailing "/"
-		for (n = strlen(requestURL) - 1; n > 0; n--)
+			return;
+		}
+		else if (strncmp(requestURL, "/calc/big", 9) == 0)
 		{
-			if (requestURL[n] == '/')
+			// HANDLING: The exact add, sub, mul, div, mod of the two decimal numbers <Number 1> and <Number 2>
+			char *operation, *token1 = NULL, *token2 = NULL, *bodyBuffer = NULL;
+			size_t bodyLength = 0;
+
+			// Move pointer to the start of the operation
+			requestURL += 9;
+
+			if (*requestURL == '\0' || (operation = strtok(++requestURL, "/")) == NULL)
 			{
-				requestURL[n] = '\0';
+				// Build HTTP response
+				buildResponseHeader(400, "text/html");
+			}
+			else if (strcmp(operation, "add") != 0 && strcmp(operation, "sub") != 0 && strcmp(operation, "mul") != 0 &&
+					 strcmp(operation, "div") != 0 && strcmp(operation, "mod") != 0)
+			{
+				// Build HTTP response
+				buildResponseHeader(404, "text/html");
+			}
+			else if (isPost && contentLength < 0)
+			{
+				// Build HTTP response
+				buildResponseHeader(411, "text/html");
+			}
+			else if (isPost && contentLength > MAX_BIG_BODY_LENGTH)
+			{
+				// Build HTTP response
+				buildResponseHeader(413, "text/html");
 			}
 			else
 			{
-				break;
+				if (isPost)
+				{
+					// Very long operands are sent in the body, separated by whitespace
+					body.remaining = contentLength;
+
+					if (!readWholeRequestBody(&body, &bodyBuffer, &bodyLength))
+					{
+						printf("ERROR: Could not read the request body of client ID: %d!\n", clientIndex);
+						closeConnection(clientIndex);
+						return;
+					}
+
+					token1 = strtok(bodyBuffer, " \t\r\n");
+					token2 = strtok(NULL, " \t\r\n");
+				}
+				else
+				{
+					token1 = strtok(NULL, "/");
+					token2 = strtok(NULL, "/");
+				}
+
+				if (token1 != NULL && token2 != NULL)
+				{
+					processBigRequest(clientIndex, operation, token1, token2, sendPayload, strncmp(protocolVersion, "HTTP/1.1", 8) == 0);
+					free(bodyBuffer);
+					return;
+				}
+
+				free(bodyBuffer);
+
+				// Build HTTP response
+				buildResponseHeader(400, "text/html");
 			}
-		}
 
-		// Check URL
-		if ((strncmp(requestURL, "/\0", 2) == 0) ||	(strncmp(requestURL, "/index.htm\0", 11) == 0))
-		{
-			requestURL = "/index.html";
-		}
+			// Send data
+			sendDataToClient(clientIndex, sendPayload, NULL);
 
-		printf("------REQUEST DATA (TRAILED)------\nrequestMethod = '%s'\nrequestURL = '%s'\nprotocolVersion = '%s'\n\n", requestMethod, requestURL, protocolVersion);
+			return;
+		}
+		else if (isPost)
+		{
+			// Only the matrix, statistics and big number routes above accept a request body
+			buildResponseHeader(405, "text/html");
+			sendDataToClient(clientIndex, false, NULL);
 
-		// HANDLER
-		if (strncmp(requestURL, "/serv/random", 12) == 0)
+			return;
+		}
+		else if (strncmp(requestURL, "/serv/random", 12) == 0)
 		{
 			// HANDLING: A random floating-point number in the range between 0 and <Number>
 			const char randomServiceTemplate[] = "<html><head><title>Random Number Service</title></head><body>Your random number between 0 and %f is %f.</body></html>";
@@ -625,13 +7810,15 @@ void processClient(int clientIndex)
 			{
 				// Generate a random number
 				srand(time(NULL));
-				result = ((double)rand() / (double)(RAND_MAX)) * number;
+				calculate(OPERATION_RANDOM, &number, NULL, &result, 1);
 
 				// Build HTTP response
 				buildResponseHeader(200, "text/html");
 
 				// Create webpage from template
+				traceStart = traceBegin();
 				snprintf(responsePayloadBuffer, MAX_PAYLOAD_LENGTH, randomServiceTemplate, number, result);
+				traceEnd(TRACE_FORMAT, traceStart);
 			}
 			else
 			{
@@ -661,13 +7848,15 @@ void processClient(int clientIndex)
 			else if (convertToDouble(++requestURL, &number) && number >= 0)
 			{
 				// Calculate result
-				result = sqrt(number);
+				calculate(OPERATION_SQRT, &number, NULL, &result, 1);
 
 				// Build HTTP response
 				buildResponseHeader(200, "text/html");
 
 				// Create webpage from template
+				traceStart = traceBegin();
 				snprintf(responsePayloadBuffer, MAX_PAYLOAD_LENGTH, squareRootTemplate, number, result);
+				traceEnd(TRACE_FORMAT, traceStart);
 			}
 			else
 			{
@@ -698,13 +7887,15 @@ void processClient(int clientIndex)
 			else if (convertToDouble(++requestURL, &number))
 			{
 				// Calculate result
-				result = sin(number);
+				calculate(OPERATION_SIN, &number, NULL, &result, 1);
 
 				// Build HTTP response
 				buildResponseHeader(200, "text/html");
 
 				// Create webpage from template
+				traceStart = traceBegin();
 				snprintf(responsePayloadBuffer, MAX_PAYLOAD_LENGTH, sinTemplate, number, result);
+				traceEnd(TRACE_FORMAT, traceStart);
 			}
 			else
 			{
@@ -735,13 +7926,15 @@ void processClient(int clientIndex)
 			else if (convertToDouble(++requestURL, &number))
 			{
 				// Calculate result
-				result = cos(number);
+				calculate(OPERATION_COS, &number, NULL, &result, 1);
 
 				// Build HTTP response
 				buildResponseHeader(200, "text/html");
 
 				// Create webpage from template
+				traceStart = traceBegin();
 				snprintf(responsePayloadBuffer, MAX_PAYLOAD_LENGTH, cosTemplate, number, result);
+				traceEnd(TRACE_FORMAT, traceStart);
 			}
 			else
 			{
@@ -772,13 +7965,174 @@ void processClient(int clientIndex)
 			else if (convertToDouble(++requestURL, &number))
 			{
 				// Calculate result
-				result = tan(number);
+				calculate(OPERATION_TAN, &number, NULL, &result, 1);
 
 				// Build HTTP response
 				buildResponseHeader(200, "text/html");
 
 				// Create webpage from template
+				traceStart = traceBegin();
 				snprintf(responsePayloadBuffer, MAX_PAYLOAD_LENGTH, tanTemplate, number, result);
+				traceEnd(TRACE_FORMAT, traceStart);
+			}
+			else
+			{
+				// Build HTTP response
+				buildResponseHeader(500, "text/html");
+			}
+
+			// Send data
+			sendDataToClient(clientIndex, sendPayload, NULL);
+
+			return;
+		}
+		else if (strncmp(requestURL, "/calc/range", 11) == 0)
+		{
+			// HANDLING: The values of the function <Function> from <Start> to <Stop> in steps of <Step>
+			char *functionName, *startToken, *stopToken, *stepToken;
+			mathFunction function = NULL;
+			double start = 0;
+			double stop = 0;
+			double step = 0;
+			double span = 0;
+
+			// Move pointer to the start of the function name
+			requestURL += 11;
+
+			if (*requestURL == '\0')
+			{
+				// Build HTTP response
+				buildResponseHeader(400, "text/html");
+				sendDataToClient(clientIndex, sendPayload, NULL);
+				return;
+			}
+
+			functionName = strtok(++requestURL, "/");
+			startToken = strtok(NULL, "/");
+			stopToken = strtok(NULL, "/");
+			stepToken = strtok(NULL, "/");
+
+			if (functionName == NULL || startToken == NULL || stopToken == NULL || stepToken == NULL)
+			{
+				// Build HTTP response
+				buildResponseHeader(400, "text/html");
+			}
+			else if ((function = findMathFunction(functionName)) == NULL)
+			{
+				// Build HTTP response
+				buildResponseHeader(404, "text/html");
+			}
+			else if (convertToDouble(startToken, &start) && convertToDouble(stopToken, &stop) && convertToDouble(stepToken, &step) && step != 0)
+			{
+				// Check the number of points
+				span = (stop - start) / step;
+
+				if (isfinite(span) && span >= 0 && span < MAX_RANGE_POINTS)
+				{
+					// Stream the values, chunked encoding requires HTTP/1.1
+					sendRangeToClient(clientIndex, sendPayload, strncmp(protocolVersion, "HTTP/1.1", 8) == 0,
+									  function, start, step, (long long)floor(span + 1e-9) + 1);
+					return;
+				}
+
+				// Build HTTP response
+				buildResponseHeader(500, "text/html");
+			}
+			else
+			{
+				// Build HTTP response
+				buildResponseHeader(500, "text/html");
+			}
+
+			// Send data
+			sendDataToClient(clientIndex, sendPayload, NULL);
+
+			return;
+		}
+		else if ((strncmp(requestURL, "/calc/integrate", 15) == 0) ||
+				 (strncmp(requestURL, "/calc/root", 10) == 0) ||
+				 (strncmp(requestURL, "/calc/minimize", 14) == 0))
+		{
+			// HANDLING: The integral, a root or the minimum of the function <Function> between <Number 1> and <Number 2>
+			const char integrateTemplate[] = "<html><head><title>Integration Calculator</title></head><body>The integral of the function %s from %.15g to %.15g is %.15g (estimated error %g).</body></html>";
+			const char rootTemplate[] = "<html><head><title>Root Finder</title></head><body>The function %s between %.15g and %.15g has a root at %.15g (function value %g).</body></html>";
+			const char minimizeTemplate[] = "<html><head><title>Minimum Finder</title></head><body>The function %s between %.15g and %.15g has its minimum %.15g at %.15g.</body></html>";
+			numericOperation operation = NUMERIC_INTEGRATE;
+			char *functionName, *token1, *token2;
+			mathFunction function = NULL;
+			double number1 = 0;
+			double number2 = 0;
+			double position = 0;
+			double value = 0;
+			double error = 0;
+			int statusCode = 0;
+
+			// Get the operation and move pointer to the start of the function name
+			if (strncmp(requestURL, "/calc/integrate", 15) == 0)
+			{
+				requestURL += 15;
+			}
+			else if (strncmp(requestURL, "/calc/root", 10) == 0)
+			{
+				operation = NUMERIC_ROOT;
+				requestURL += 10;
+			}
+			else
+			{
+				operation = NUMERIC_MINIMIZE;
+				requestURL += 14;
+			}
+
+			if (*requestURL == '\0')
+			{
+				// Build HTTP response
+				buildResponseHeader(400, "text/html");
+				sendDataToClient(clientIndex, sendPayload, NULL);
+				return;
+			}
+
+			functionName = strtok(++requestURL, "/");
+			token1 = strtok(NULL, "/");
+			token2 = strtok(NULL, "/");
+
+			if (functionName == NULL || token1 == NULL || token2 == NULL)
+			{
+				// Build HTTP response
+				buildResponseHeader(400, "text/html");
+			}
+			else if ((function = findMathFunction(functionName)) == NULL)
+			{
+				// Build HTTP response
+				buildResponseHeader(404, "text/html");
+			}
+			else if (convertToDouble(token1, &number1) && convertToDouble(token2, &number2) &&
+					 isfinite(number1) && isfinite(number2) && (operation == NUMERIC_INTEGRATE || number1 < number2))
+			{
+				// Calculate result
+				statusCode = solveNumeric(operation, function, number1, number2, &position, &value, &error);
+
+				// Build HTTP response
+				buildResponseHeader(statusCode, "text/html");
+
+				// Create webpage from template
+				if (statusCode == 200 && operation == NUMERIC_INTEGRATE)
+				{
+					traceStart = traceBegin();
+					snprintf(responsePayloadBuffer, MAX_PAYLOAD_LENGTH, integrateTemplate, functionName, number1, number2, value, error);
+					traceEnd(TRACE_FORMAT, traceStart);
+				}
+				else if (statusCode == 200 && operation == NUMERIC_ROOT)
+				{
+					traceStart = traceBegin();
+					snprintf(responsePayloadBuffer, MAX_PAYLOAD_LENGTH, rootTemplate, functionName, number1, number2, position, value);
+					traceEnd(TRACE_FORMAT, traceStart);
+				}
+				else if (statusCode == 200)
+				{
+					traceStart = traceBegin();
+					snprintf(responsePayloadBuffer, MAX_PAYLOAD_LENGTH, minimizeTemplate, functionName, number1, number2, value, position);
+					traceEnd(TRACE_FORMAT, traceStart);
+				}
 			}
 			else
 			{
@@ -805,6 +8159,7 @@ void processClient(int clientIndex)
 			memcpy(operationBuffer, requestURL, 3);
 
 			const char calcTemplate[] = "<html><head><title>Calculator</title></head><body>The result of your requested operation (%s) is %f.</body></html>";
+			calcOperation operation = OPERATION_ADD;
 			double number1 = 0;
 			double number2 = 0;
 			double result = 0;
@@ -841,56 +8196,44 @@ void processClient(int clientIndex)
 						// Calculate result
 						if (strncmp(operationBuffer, "add", 3) == 0)
 						{
-							result = number1 + number2;
+							operation = OPERATION_ADD;
 						}
 						else if (strncmp(operationBuffer, "sub", 3) == 0)
 						{
-							result = number1 - number2;
+							operation = OPERATION_SUB;
 						}
 						else if (strncmp(operationBuffer, "mul", 3) == 0)
 						{
-							result = number1 * number2;
+							operation = OPERATION_MUL;
 						}
 						else if (strncmp(operationBuffer, "div", 3) == 0)
 						{
-							if (number2 == 0)
-							{
-								// Build HTTP response
-								buildResponseHeader(500, "text/html");
-
-								// Send data
-								sendDataToClient(clientIndex, sendPayload, NULL);
-
-								return;
-							}
-							else
-							{
-								result = number1 / number2;
-							}
+							operation = OPERATION_DIV;
+						}
+						else
+						{
+							operation = OPERATION_MOD;
 						}
-						else if (strncmp(operationBuffer, "mod", 3) == 0)
+
+						// Division by zero or operands of mod outside of the int range
+						if (calculate(operation, &number1, &number2, &result, 1) != 0)
 						{
-							if (number2 == 0)
-							{
-								// Build HTTP response
-								buildResponseHeader(500, "text/html");
-
-								// Send data
-								sendDataToClient(clientIndex, sendPayload, NULL);
-
-								return;
-							}
-							else
-							{
-								result = (int)number1 % (int)number2;
-							}
+							// Build HTTP response
+							buildResponseHeader(500, "text/html");
+
+							// Send data
+							sendDataToClient(clientIndex, sendPayload, NULL);
+
+							return;
 						}
 
 						// Build HTTP response
 						buildResponseHeader(200, "text/html");
 
 						// Create webpage from template
+						traceStart = traceBegin();
 						snprintf(responsePayloadBuffer, MAX_PAYLOAD_LENGTH, calcTemplate, operationBuffer, result);
+						traceEnd(TRACE_FORMAT, traceStart);
 					}
 					else
 					{
@@ -912,8 +8255,8 @@ void processClient(int clientIndex)
 		}
 		else
 		{
-			// HANDLING: Send a File
-			sendDataToClient(clientIndex, sendPayload, requestURL);
+			// HANDLING: Send a File (from memory in the negotiated encoding)
+			sendStaticAsset(clientIndex, sendPayload, requestURL, encodings);
 		}
     }
 }
@@ -925,11 +8268,23 @@ void processClient(int clientIndex)
 void SIGCHLD_handler(int signo)
 {
 	pid_t pid;
-	int stat;
+	int stat, n;
+	int savedErrno = errno;
 
-	while ((pid = waitpid(-1, &stat, WNOHANG)) > 0);
+	while ((pid = waitpid(-1, &stat, WNOHANG)) > 0)
+	{
+		// Forget finished client processes
+		for (n = 0; n < clientProcessCount; n++)
+		{
+			if (clientProcesses[n] == pid)
+			{
+				clientProcesses[n] = clientProcesses[--clientProcessCount];
+				break;
+			}
+		}
+	}
 
-	// optional actions, usually nothing ;
+	errno = savedErrno;
 	return;
 }
 
@@ -946,3 +8301,37 @@ void install_SIGCHLD_handler(void)
  	act.sa_flags = SA_RESTART;
 	sigaction (SIGCHLD, &act, NULL);
 }
+
+// SIGUSR1 handler, the main loop writes the request traces
+void SIGUSR1_handler(int signo)
+{
+	traceDumpRequested = 1;
+}
+
+// installer for the SIGUSR1 handler
+void install_SIGUSR1_handler(void)
+{
+	struct sigaction act;
+
+	sigfillset(&act.sa_mask);
+	act.sa_handler = &SIGUSR1_handler;
+	act.sa_flags = 0;
+	sigaction(SIGUSR1, &act, NULL);
+}
+
+// SIGUSR2 handler, the main loop starts the graceful restart
+void SIGUSR2_handler(int signo)
+{
+	restartRequested = 1;
+}
+
+// installer for the SIGUSR2 handler
+void install_SIGUSR2_handler(void)
+{
+	struct sigaction act;
+
+	sigfillset(&act.sa_mask);
+	act.sa_handler = &SIGUSR2_handler;
+	act.sa_flags = 0;
+	sigaction(SIGUSR2, &act, NULL);
+}